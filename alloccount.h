@@ -0,0 +1,22 @@
+#ifndef ALLOCCOUNT_H
+#define ALLOCCOUNT_H
+#include <cstdint>
+
+// Counting hook for the global allocator.
+// Linking alloccount.cpp into a program replaces the global operator new and
+// operator delete with versions that count every call before forwarding to malloc
+// and free. Allocations made directly through malloc are not counted.
+
+/**
+ * Number of operator new calls since the program started.
+ * @return  allocation count.
+ */
+std::uint64_t allocationCount();
+
+/**
+ * Bytes requested through operator new since the program started.
+ * @return  allocated bytes.
+ */
+std::uint64_t allocatedBytes();
+
+#endif
@@ -0,0 +1,80 @@
+#include <algorithm>
+#include "arena.h"
+#include "mapmemory.h"
+
+namespace {
+
+const std::size_t CHUNK_HEADER = ARENA_CHUNK_HEADER;
+
+}
+
+Arena::Arena(void* buffer, std::size_t bytes) {
+    first = static_cast<Chunk*>(buffer);
+    first->next = nullptr;
+    first->size = bytes;
+    current = first;
+    inlineChunk = first;
+    offset = CHUNK_HEADER;
+    capacityBytes = bytes;
+    chunkCount = 1;
+}
+
+Arena::~Arena() {
+    if (mapArena() == this) {
+        setMapArena(nullptr);
+    }
+    Chunk* chunk = first;
+    while (chunk != nullptr) {
+        Chunk* next = chunk->next;
+        if (chunk != inlineChunk) {
+            mapFree(chunk);
+        }
+        chunk = next;
+    }
+}
+
+void* Arena::allocate(std::size_t bytes) {
+    std::size_t size = (bytes + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+
+    // move on to the next kept chunk when this one is full
+    Chunk* last = current;
+    while (current != nullptr && offset + size > current->size) {
+        last = current;
+        current = current->next;
+        offset = CHUNK_HEADER;
+    }
+
+    if (current == nullptr) {
+        // grow geometrically so a room needs few chunks
+        std::size_t chunkSize = std::max({ARENA_MIN_CHUNK, size + CHUNK_HEADER,
+                                          static_cast<std::size_t>(capacityBytes)});
+        Chunk* chunk = static_cast<Chunk*>(mapAllocHeap(chunkSize));
+        if (chunk == nullptr) {
+            current = last;
+            offset = last != nullptr ? last->size : 0;
+            return nullptr;
+        }
+        chunk->next = nullptr;
+        chunk->size = chunkSize;
+        if (last == nullptr) {
+            first = chunk;
+        } else {
+            last->next = chunk;
+        }
+        current = chunk;
+        offset = CHUNK_HEADER;
+        capacityBytes += chunkSize;
+        chunkCount++;
+    }
+
+    void* block = reinterpret_cast<char*>(current) + offset;
+    offset += size;
+    usedBytes += size;
+    return block;
+}
+
+void Arena::reset() {
+    current = first;
+    offset = CHUNK_HEADER;
+    usedBytes = 0;
+}
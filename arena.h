@@ -0,0 +1,96 @@
+#ifndef ARENA_H
+#define ARENA_H
+#include <cstddef>
+#include <cstdint>
+#include "mapmemory.h"
+
+// smallest chunk an arena requests from map memory
+const std::size_t ARENA_MIN_CHUNK = 64 * 1024;
+
+// alignment of every arena allocation
+const std::size_t ARENA_ALIGNMENT = 16;
+
+// bytes at the start of every chunk taken by its header, keeping blocks aligned
+const std::size_t ARENA_CHUNK_HEADER = 16;
+
+/**
+ * Arena bytes needed to hold any map of up to the given number of tiles.
+ * A map is one block of tiles followed by its row pointers, so a single-column map,
+ * with a row pointer for every tile, is the worst case.
+ * @param   tiles       Number of tiles.
+ * @return  bytes including the chunk header.
+ */
+constexpr std::size_t smallRoomBytes(std::size_t tiles) {
+    return ARENA_CHUNK_HEADER
+         + (MAP_HEADER_BYTES + (tiles + sizeof(char*) - 1) / sizeof(char*) * sizeof(char*)
+            + tiles * sizeof(char*) + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+}
+
+// Bump allocator for storage that lives as long as one room.
+// Chunks come from tracked map memory and are kept after reset, so once the arena
+// has grown to fit the largest room, later rooms reuse it without touching the heap.
+class Arena {
+public:
+    Arena() = default;
+
+    /**
+     * Use caller-owned storage as the first chunk. It is never freed by the arena.
+     * @param   buffer      16-byte aligned storage that outlives the arena.
+     * @param   bytes       Size of the storage, at least ARENA_CHUNK_HEADER.
+     */
+    Arena(void* buffer, std::size_t bytes);
+
+    ~Arena();
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    /**
+     * Allocate from the arena, adding a chunk if the current ones are full.
+     * @param   bytes       Size of the block.
+     * @return  16-byte aligned block, or nullptr if a new chunk exceeds the memory budget.
+     */
+    void* allocate(std::size_t bytes);
+
+    /**
+     * Release everything allocated so far in O(1). The chunks are kept for reuse.
+     * @return None
+     */
+    void reset();
+
+    // bytes handed out since the last reset
+    std::uint64_t used() const { return usedBytes; }
+
+    // bytes held in chunks
+    std::uint64_t capacity() const { return capacityBytes; }
+
+    // number of chunks held
+    int chunks() const { return chunkCount; }
+
+private:
+    struct Chunk {
+        Chunk* next;
+        std::size_t size;
+    };
+
+    Chunk* first = nullptr;
+    Chunk* current = nullptr;
+    Chunk* inlineChunk = nullptr;
+    std::size_t offset = 0;
+    std::uint64_t usedBytes = 0;
+    std::uint64_t capacityBytes = 0;
+    int chunkCount = 0;
+};
+
+// Arena whose first chunk is Bytes of inline storage, so it can live in the game state
+// and serve everything that fits without reaching the heap. Anything more spills into
+// heap chunks as usual.
+template <std::size_t Bytes>
+class InlineArena : public Arena {
+public:
+    InlineArena() : Arena(storage, sizeof(storage)) {}
+
+private:
+    alignas(ARENA_ALIGNMENT) char storage[Bytes];
+};
+
+#endif
@@ -0,0 +1,236 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include "baseline.h"
+using std::endl, std::string, std::vector, std::ifstream, std::ofstream;
+
+// first line of every baseline file
+const string BASELINE_HEADER = "# dungeon-escape benchmark baseline v1";
+
+
+double median(vector<double> samples) {
+    if (samples.empty()) {
+        return 0.0;
+    }
+    std::sort(samples.begin(), samples.end());
+    size_t mid = samples.size() / 2;
+    if (samples.size() % 2 == 0) {
+        return (samples[mid - 1] + samples[mid]) / 2.0;
+    }
+    return samples[mid];
+}
+
+void medianInterval(vector<double> samples, double& low, double& high) {
+    low = 0.0;
+    high = 0.0;
+    if (samples.empty()) {
+        return;
+    }
+    std::sort(samples.begin(), samples.end());
+    int n = samples.size();
+    if (n < 6) {
+        low = samples.front();
+        high = samples.back();
+        return;
+    }
+    // ranks n/2 -+ 1.96 * sqrt(n) / 2 bound the median with ~95% confidence
+    double spread = 1.96 * std::sqrt(static_cast<double>(n)) / 2.0;
+    int lowRank = std::max(0, static_cast<int>(std::floor(n / 2.0 - spread)));
+    int highRank = std::min(n - 1, static_cast<int>(std::ceil(n / 2.0 + spread)) - 1);
+    low = samples[lowRank];
+    high = samples[highRank];
+}
+
+double rankSumPValue(const vector<double>& a, const vector<double>& b) {
+    size_t n1 = a.size();
+    size_t n2 = b.size();
+    if (n1 == 0 || n2 == 0) {
+        return 1.0;
+    }
+
+    // rank the pooled samples, giving ties their average rank
+    vector<std::pair<double, int>> pooled;
+    for (double value : a) {
+        pooled.push_back({value, 0});
+    }
+    for (double value : b) {
+        pooled.push_back({value, 1});
+    }
+    std::sort(pooled.begin(), pooled.end());
+
+    double rankSumA = 0.0;
+    double tieTerm = 0.0;
+    size_t i = 0;
+    while (i < pooled.size()) {
+        size_t j = i;
+        while (j < pooled.size() && pooled[j].first == pooled[i].first) {
+            j++;
+        }
+        double rank = (i + 1 + j) / 2.0;
+        for (size_t k = i; k < j; ++k) {
+            if (pooled[k].second == 0) {
+                rankSumA += rank;
+            }
+        }
+        double ties = j - i;
+        tieTerm += ties * ties * ties - ties;
+        i = j;
+    }
+
+    double n = n1 + n2;
+    double u = rankSumA - n1 * (n1 + 1) / 2.0;
+    double mean = n1 * n2 / 2.0;
+    double variance = n1 * n2 / 12.0 * ((n + 1) - tieTerm / (n * (n - 1)));
+    if (variance <= 0.0) {
+        return 1.0;
+    }
+    double z = (std::fabs(u - mean) - 0.5) / std::sqrt(variance);
+    if (z < 0.0) {
+        return 1.0;
+    }
+    return std::erfc(z / std::sqrt(2.0));
+}
+
+bool saveBaseline(const string& fileName, const vector<BaselineEntry>& entries) {
+    ofstream ofs(fileName);
+    if (!ofs.is_open()) {
+        std::cerr << "Error: File unable to open: " << fileName << endl;
+        return false;
+    }
+    ofs.precision(10);
+    ofs << BASELINE_HEADER << "\n";
+    ofs << "# function rows cols density count samples...\n";
+    for (const BaselineEntry& entry : entries) {
+        ofs << entry.function << " " << entry.rows << " " << entry.cols << " "
+            << entry.density << " " << entry.samples.size();
+        for (double sample : entry.samples) {
+            ofs << " " << sample;
+        }
+        ofs << "\n";
+    }
+    return static_cast<bool>(ofs);
+}
+
+bool loadBaseline(const string& fileName, vector<BaselineEntry>& entries) {
+    ifstream ifs(fileName);
+    if (!ifs.is_open()) {
+        std::cerr << "Error: File unable to open: " << fileName << endl;
+        return false;
+    }
+    string line;
+    if (!std::getline(ifs, line) || line != BASELINE_HEADER) {
+        std::cerr << "Error: " << fileName << " is not a benchmark baseline" << endl;
+        return false;
+    }
+    entries.clear();
+    while (std::getline(ifs, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream iss(line);
+        BaselineEntry entry;
+        size_t count = 0;
+        iss >> entry.function >> entry.rows >> entry.cols >> entry.density >> count;
+        entry.samples.resize(count);
+        for (double& sample : entry.samples) {
+            iss >> sample;
+        }
+        if (!iss) {
+            std::cerr << "Error: malformed baseline line: " << line << endl;
+            return false;
+        }
+        entries.push_back(entry);
+    }
+    return true;
+}
+
+int compareBaseline(const vector<BaselineEntry>& baseline, const vector<BaselineEntry>& current,
+                    const vector<string>& gated, double threshold, double alpha, std::ostream& out) {
+    int regressions = 0;
+    int compared = 0;
+    int untested = 0;
+    out.setf(std::ios::fixed);
+    out.precision(1);
+    out << "function           size         base ns/op (95% CI)            "
+        << "new ns/op (95% CI)             change      p  verdict" << endl;
+
+    for (const BaselineEntry& now : current) {
+        auto old = std::find_if(baseline.begin(), baseline.end(), [&](const BaselineEntry& entry) {
+            return entry.function == now.function && entry.rows == now.rows &&
+                   entry.cols == now.cols && entry.density == now.density;
+        });
+        if (old == baseline.end()) {
+            continue;
+        }
+        compared++;
+
+        double oldMedian = median(old->samples);
+        double newMedian = median(now.samples);
+        double oldLow, oldHigh, newLow, newHigh;
+        medianInterval(old->samples, oldLow, oldHigh);
+        medianInterval(now.samples, newLow, newHigh);
+        double change = oldMedian > 0.0 ? newMedian / oldMedian - 1.0 : 0.0;
+        double p = rankSumPValue(old->samples, now.samples);
+        bool isGated = std::find(gated.begin(), gated.end(), now.function) != gated.end();
+
+        string verdict = "ok";
+        std::size_t fewest = std::min(old->samples.size(), now.samples.size());
+        if (fewest < static_cast<std::size_t>(MIN_RANK_SUM_SAMPLES)) {
+            verdict = isGated ? "TOO FEW SAMPLES" : "too few samples (not gated)";
+            if (isGated) {
+                regressions++;
+                untested++;
+            }
+        } else if (change > threshold && p < alpha) {
+            verdict = isGated ? "REGRESSION" : "slower (not gated)";
+            if (isGated) {
+                regressions++;
+            }
+        } else if (change < -threshold && p < alpha) {
+            verdict = "faster";
+        }
+
+        std::ostringstream size;
+        size << now.rows << "x" << now.cols << "/" << now.density;
+        std::ostringstream base;
+        base.setf(std::ios::fixed);
+        base.precision(1);
+        base << oldMedian << " (" << oldLow << "-" << oldHigh << ")";
+        std::ostringstream fresh;
+        fresh.setf(std::ios::fixed);
+        fresh.precision(1);
+        fresh << newMedian << " (" << newLow << "-" << newHigh << ")";
+
+        out.width(18);
+        out << std::left << now.function << " ";
+        out.width(12);
+        out << size.str() << " ";
+        out.width(30);
+        out << base.str() << " ";
+        out.width(30);
+        out << fresh.str() << " ";
+        out.width(6);
+        out << std::right << change * 100.0 << "% ";
+        out.precision(3);
+        out.width(6);
+        out << p << "  " << verdict << endl;
+        out.precision(1);
+    }
+
+    out << compared << " benchmarks compared, " << regressions - untested << " gated regressions beyond "
+        << threshold * 100.0 << "%" << endl;
+    if (compared == 0) {
+        out << "Warning: no benchmark matched the baseline" << endl;
+    }
+    if (untested > 0) {
+        out.precision(2);
+        out << "Error: " << untested << " gated benchmark(s) have fewer than " << MIN_RANK_SUM_SAMPLES
+            << " samples on a side, so the rank-sum test cannot reach p < " << alpha
+            << "; run both sides with --repetitions " << MIN_RANK_SUM_SAMPLES << " or more" << endl;
+    }
+    return regressions;
+}
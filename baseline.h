@@ -0,0 +1,88 @@
+#ifndef BASELINE_H
+#define BASELINE_H
+#include <iostream>
+#include <string>
+#include <vector>
+
+// repeated ns/op samples of one (function, size, density) benchmark
+struct BaselineEntry {
+    std::string function;
+    int rows = 0;
+    int cols = 0;
+    double density = 0.0;
+    std::vector<double> samples;
+};
+
+// default relative slowdown of the median that counts as a regression
+const double DEFAULT_REGRESSION_THRESHOLD = 0.10;
+
+// default significance level for the rank-sum test
+const double DEFAULT_REGRESSION_ALPHA = 0.05;
+
+// fewest samples per side with which the rank-sum test can reach p < 0.05;
+// with three a side the smallest p is 0.081, with one it is always 1
+const int MIN_RANK_SUM_SAMPLES = 4;
+
+
+/**
+ * Median of a set of samples.
+ * @param   samples     Benchmark samples, need not be sorted.
+ * @return  median value, or 0 for an empty set.
+ */
+double median(std::vector<double> samples);
+
+/**
+ * Distribution-free 95% confidence interval of the median, from order statistics.
+ * With fewer than six samples the interval is the sample range.
+ * @param   samples     Benchmark samples, need not be sorted.
+ * @param   low         Lower bound of the interval.
+ * @param   high        Upper bound of the interval.
+ * @return None
+ * @update low, high
+ */
+void medianInterval(std::vector<double> samples, double& low, double& high);
+
+/**
+ * Two-sided Mann-Whitney U test on two sample sets (normal approximation).
+ * @param   a           First sample set.
+ * @param   b           Second sample set.
+ * @return  p-value for the hypothesis that both sets come from the same distribution.
+ */
+double rankSumPValue(const std::vector<double>& a, const std::vector<double>& b);
+
+/**
+ * Write benchmark samples to a baseline file, one entry per line.
+ * @param   fileName    Baseline file name.
+ * @param   entries     Entries to store.
+ * @return  true if the file was written.
+ */
+bool saveBaseline(const std::string& fileName, const std::vector<BaselineEntry>& entries);
+
+/**
+ * Read a baseline file written by saveBaseline.
+ * @param   fileName    Baseline file name.
+ * @param   entries     Entries read from the file.
+ * @return  true if the file was read without errors.
+ * @update entries
+ */
+bool loadBaseline(const std::string& fileName, std::vector<BaselineEntry>& entries);
+
+/**
+ * Compare current samples against a baseline and print a report.
+ * An entry regresses when its median slowed down by more than threshold
+ * and the rank-sum test rejects equality at level alpha.
+ * An entry with fewer than MIN_RANK_SUM_SAMPLES samples on either side cannot be
+ * tested and is reported as such.
+ * Only regressions and untestable entries of the gated functions count towards the result.
+ * @param   baseline    Stored entries.
+ * @param   current     Entries from the current run.
+ * @param   gated       Function names that fail the comparison when they regress.
+ * @param   threshold   Relative slowdown tolerated, e.g. 0.10 for 10%.
+ * @param   alpha       Significance level of the rank-sum test.
+ * @param   out         Stream receiving the report.
+ * @return  number of gated entries that regressed or could not be tested.
+ */
+int compareBaseline(const std::vector<BaselineEntry>& baseline, const std::vector<BaselineEntry>& current,
+                    const std::vector<std::string>& gated, double threshold, double alpha, std::ostream& out);
+
+#endif
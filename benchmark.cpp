@@ -0,0 +1,1392 @@
+// Scaling benchmark for the logic.cpp entry points and outputMap.
+// Build:  g++ -std=c++17 -O2 benchmark.cpp baseline.cpp logic.cpp helper.cpp mapmemory.cpp arena.cpp packedmap.cpp rlemap.cpp sparsemap.cpp tiledmap.cpp chunkedmap.cpp pillarindex.cpp flowfield.cpp entities.cpp -pthread -o benchmark
+//         add -DDUNGEON_PERF perfcounters.cpp profile.cpp to count dTLB misses of the page size benchmarks
+// Usage:  ./benchmark [--min-size N] [--max-size N] [--densities a,b,...]
+//                     [--min-time MS] [--repetitions N] [--functions f,g,...] [--out FILE]
+//                     [--save-baseline FILE] [--compare FILE] [--threshold PCT] [--gate f,g,...]
+//                     [--threads N]
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <functional>
+#include <algorithm>
+#include "baseline.h"
+#include "helper.h"
+#include "logic.h"
+#include "mapops.h"
+#include "packedmap.h"
+#include "rlemap.h"
+#include "sparsemap.h"
+#include "tiledmap.h"
+#include "chunkedmap.h"
+#include "entities.h"
+#include "mapmemory.h"
+#include "parallel.h"
+#include "perfcounters.h"
+#include "pillarindex.h"
+#include "flowfield.h"
+#include "room.h"
+using std::cout, std::cerr, std::endl, std::string, std::vector, std::ofstream;
+
+using Clock = std::chrono::steady_clock;
+
+// upper bound on the tiles held by one measurement batch of maps
+const long long BATCH_TILE_BUDGET = 1LL << 26;
+
+// settings taken from the command line
+struct BenchConfig {
+    int minSize = 8;
+    int maxSize = 8192;
+    double minTimeMs = 50.0;
+    int repetitions = MIN_RANK_SUM_SAMPLES;
+    vector<double> densities = {0.0, 0.01, 0.1};
+    vector<string> functions;
+    string outFile;
+    string saveBaselineFile;
+    string compareFile;
+    double threshold = DEFAULT_REGRESSION_THRESHOLD;
+    vector<string> gated = {"doMonsterAttack", "loadLevel", "resizeMap", "outputMap"};
+    unsigned threads = 0;   // threads of parallel map work, 0 for one per core
+};
+
+// one timed (function, size, density) measurement
+struct BenchResult {
+    string function;
+    int rows = 0;
+    int cols = 0;
+    double density = 0.0;
+    long long iterations = 0;
+    double nsPerOp = 0.0;
+    double tilesPerOp = 0.0;
+    double mapBytes = 0.0;  // map storage for layout benchmarks, 0 if not measured
+    double hugePageBytes = -1.0;  // map storage backed by huge pages, -1 if not measured
+    double tlbMissesPerOp = -1.0; // dTLB read misses per operation, -1 if not measured
+    vector<double> samples;
+};
+
+// least-squares fit of ns/op against one complexity curve
+struct ComplexityFit {
+    string function;
+    double density = 0.0;
+    string bigO;
+    double coefficient = 0.0;
+    double rms = 0.0;
+};
+
+// stream buffer that discards everything, used as outputMap's sink
+class NullBuffer : public std::streambuf {
+public:
+    NullBuffer() { setp(buffer, buffer + sizeof(buffer)); }
+protected:
+    int overflow(int c) override {
+        setp(buffer, buffer + sizeof(buffer));
+        return c == EOF ? 0 : c;
+    }
+private:
+    char buffer[4096];
+};
+
+/**
+ * Time a batched operation until at least minTimeMs has been spent in it.
+ * The batch size doubles after every round, capped at maxBatch.
+ * @param   runBatch    Runs k operations and returns the nanoseconds spent in the timed part.
+ * @param   maxBatch    Largest number of operations to run in one batch.
+ * @param   minTimeMs   Minimum accumulated timed duration.
+ * @param   iterations  Total number of timed operations.
+ * @return  Mean nanoseconds per operation.
+ * @update  iterations
+ */
+double measure(const std::function<double(long long)>& runBatch, long long maxBatch,
+               double minTimeMs, long long& iterations) {
+    runBatch(1); // warm up caches and the allocator
+
+    double totalNs = 0.0;
+    long long batch = 1;
+    iterations = 0;
+    while (totalNs < minTimeMs * 1e6) {
+        totalNs += runBatch(batch);
+        iterations += batch;
+        if (batch < maxBatch) {
+            batch = std::min(batch * 2, maxBatch);
+        }
+    }
+    return totalNs / iterations;
+}
+
+/**
+ * Repeat a measurement config.repetitions times, keeping every ns/op sample.
+ * The reported ns/op is the median sample.
+ * @param   config      Benchmark settings.
+ * @param   result      Measurement being filled in.
+ * @param   runBatch    Runs k operations and returns the nanoseconds spent in the timed part.
+ * @param   maxBatch    Largest number of operations to run in one batch.
+ * @return None
+ * @update result
+ */
+void sample(const BenchConfig& config, BenchResult& result,
+            const std::function<double(long long)>& runBatch, long long maxBatch) {
+    result.iterations = 0;
+    result.samples.clear();
+    for (int rep = 0; rep < config.repetitions; ++rep) {
+        long long iterations = 0;
+        result.samples.push_back(measure(runBatch, maxBatch, config.minTimeMs, iterations));
+        result.iterations += iterations;
+    }
+    result.nsPerOp = median(result.samples);
+}
+
+double elapsedNs(Clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+/**
+ * Build a level with the player in the middle and monsters scattered at the given density.
+ * No pillars are placed, so every line-of-sight scan runs to the map edge.
+ * @param   maxRow      Number of rows.
+ * @param   maxCol      Number of columns.
+ * @param   density     Fraction of tiles holding a monster.
+ * @param   player      Player object set to the starting position.
+ * @return  map allocated by createMap.
+ * @update  player
+ */
+char** makeLevel(int maxRow, int maxCol, double density, Player& player) {
+    char** map = createMap(maxRow, maxCol);
+    std::mt19937 rng(maxRow * 31 + maxCol);
+    std::bernoulli_distribution monster(density);
+    for (int i = 0; i < maxRow; ++i) {
+        for (int j = 0; j < maxCol; ++j) {
+            if (density > 0.0 && monster(rng)) {
+                map[i][j] = TILE_MONSTER;
+            }
+        }
+    }
+    player = Player();
+    player.row = maxRow / 2;
+    player.col = maxCol / 2;
+    map[player.row][player.col] = TILE_PLAYER;
+    map[player.row][player.col + 1] = TILE_OPEN;
+    return map;
+}
+
+/**
+ * Write a map in the text level format read by loadLevel.
+ * @param   fileName    Destination file.
+ * @param   map         Dungeon map.
+ * @param   maxRow      Number of rows.
+ * @param   maxCol      Number of columns.
+ * @param   player      Player starting position.
+ * @return  true if the file was written.
+ */
+bool writeLevel(const string& fileName, char** map, int maxRow, int maxCol, const Player& player) {
+    ofstream ofs(fileName);
+    if (!ofs.is_open()) {
+        return false;
+    }
+    ofs << maxRow << " " << maxCol << "\n" << player.row << " " << player.col << "\n";
+    for (int i = 0; i < maxRow; ++i) {
+        ofs.write(map[i], maxCol);
+        ofs << "\n";
+    }
+    return static_cast<bool>(ofs);
+}
+
+BenchResult newResult(const string& function, int size, double density) {
+    BenchResult result;
+    result.function = function;
+    result.rows = size;
+    result.cols = size;
+    result.density = density;
+    return result;
+}
+
+long long batchLimit(long long tilesPerMap) {
+    return std::max(1LL, BATCH_TILE_BUDGET / std::max(1LL, tilesPerMap));
+}
+
+bool selected(const BenchConfig& config, const string& function) {
+    return config.functions.empty() ||
+           std::find(config.functions.begin(), config.functions.end(), function) != config.functions.end();
+}
+
+void benchCreateMap(const BenchConfig& config, int size, vector<BenchResult>& results) {
+    BenchResult result = newResult("createMap", size, 0.0);
+    long long tiles = 1LL * size * size;
+    sample(config, result, [&](long long k) {
+        vector<char**> maps(k);
+        auto start = Clock::now();
+        for (long long n = 0; n < k; ++n) {
+            maps[n] = createMap(size, size);
+        }
+        double ns = elapsedNs(start);
+        for (char**& map : maps) {
+            int rows = size;
+            deleteMap(map, rows);
+        }
+        return ns;
+    }, batchLimit(tiles));
+    result.tilesPerOp = tiles;
+    results.push_back(result);
+}
+
+void benchDeleteMap(const BenchConfig& config, int size, vector<BenchResult>& results) {
+    BenchResult result = newResult("deleteMap", size, 0.0);
+    long long tiles = 1LL * size * size;
+    sample(config, result, [&](long long k) {
+        vector<char**> maps(k);
+        for (char**& map : maps) {
+            map = createMap(size, size);
+        }
+        auto start = Clock::now();
+        for (char**& map : maps) {
+            int rows = size;
+            deleteMap(map, rows);
+        }
+        return elapsedNs(start);
+    }, batchLimit(tiles));
+    result.tilesPerOp = tiles;
+    results.push_back(result);
+}
+
+void benchResizeMap(const BenchConfig& config, int size, vector<BenchResult>& results) {
+    BenchResult result = newResult("resizeMap", size, 0.0);
+    long long tiles = 4LL * size * size;
+    sample(config, result, [&](long long k) {
+        vector<char**> maps(k);
+        vector<Player> players(k);
+        for (long long i = 0; i < k; ++i) {
+            maps[i] = makeLevel(size, size, 0.0, players[i]);
+        }
+        auto start = Clock::now();
+        for (long long i = 0; i < k; ++i) {
+            int rows = size;
+            int cols = size;
+            maps[i] = resizeMap(maps[i], rows, cols, players[i]);
+        }
+        double ns = elapsedNs(start);
+        for (char**& map : maps) {
+            int rows = 2 * size;
+            deleteMap(map, rows);
+        }
+        return ns;
+    }, batchLimit(tiles));
+    result.tilesPerOp = tiles;
+    results.push_back(result);
+}
+
+void benchPlayerMove(const BenchConfig& config, int size, vector<BenchResult>& results) {
+    BenchResult result = newResult("doPlayerMove", size, 0.0);
+    Player player;
+    char** map = makeLevel(size, size, 0.0, player);
+    int homeCol = player.col;
+    volatile int sink = 0;
+    sample(config, result, [&](long long k) {
+        auto start = Clock::now();
+        for (long long n = 0; n < k; ++n) {
+            // step right and back so the map returns to its starting state
+            int nextCol = (player.col == homeCol) ? homeCol + 1 : homeCol;
+            sink = sink + doPlayerMove(map, size, size, player, player.row, nextCol);
+        }
+        return elapsedNs(start);
+    }, 1LL << 30);
+    result.tilesPerOp = 1;
+    results.push_back(result);
+    deleteMap(map, size);
+}
+
+void benchMonsterAttack(const BenchConfig& config, int size, double density, vector<BenchResult>& results) {
+    BenchResult result = newResult("doMonsterAttack", size, density);
+    Player player;
+    char** map = makeLevel(size, size, density, player);
+
+    // monsters converge on the player, so the player's row and column are restored between rounds
+    vector<char> savedRow(map[player.row], map[player.row] + size);
+    vector<char> savedCol(size);
+    for (int i = 0; i < size; ++i) {
+        savedCol[i] = map[i][player.col];
+    }
+    const long long roundLength = 16;
+
+    volatile bool sink = false;
+    sample(config, result, [&](long long k) {
+        double ns = 0.0;
+        for (long long done = 0; done < k; done += roundLength) {
+            long long count = std::min(roundLength, k - done);
+            auto start = Clock::now();
+            for (long long n = 0; n < count; ++n) {
+                sink = doMonsterAttack(map, size, size, player);
+            }
+            ns += elapsedNs(start);
+            for (int i = 0; i < size; ++i) {
+                map[i][player.col] = savedCol[i];
+            }
+            std::copy(savedRow.begin(), savedRow.end(), map[player.row]);
+        }
+        return ns;
+    }, 1LL << 30);
+    (void)sink;
+    result.tilesPerOp = 2.0 * size;
+    result.mapBytes = 1.0 * size * (size + sizeof(char*));
+    results.push_back(result);
+    deleteMap(map, size);
+}
+
+/**
+ * Time building the pillar index and monster turns that use it, on the same levels
+ * as doMonsterAttack.
+ * @return None
+ * @update results
+ */
+void benchPillarIndex(const BenchConfig& config, int size, double density, vector<BenchResult>& results) {
+    Player player;
+    char** map = makeLevel(size, size, density, player);
+    PillarIndex pillars;
+
+    if (selected(config, "pillarIndexBuild")) {
+        BenchResult result = newResult("pillarIndexBuild", size, density);
+        sample(config, result, [&](long long k) {
+            auto start = Clock::now();
+            for (long long n = 0; n < k; ++n) {
+                pillars.build(map, size, size);
+            }
+            return elapsedNs(start);
+        }, batchLimit(1LL * size * size));
+        result.tilesPerOp = 1.0 * size * size;
+        results.push_back(result);
+    }
+
+    if (selected(config, "indexedMonsterAttack") && pillars.build(map, size, size)) {
+        BenchResult result = newResult("indexedMonsterAttack", size, density);
+        vector<char> savedRow(map[player.row], map[player.row] + size);
+        vector<char> savedCol(size);
+        for (int i = 0; i < size; ++i) {
+            savedCol[i] = map[i][player.col];
+        }
+        const long long roundLength = 16;
+
+        volatile bool sink = false;
+        sample(config, result, [&](long long k) {
+            double ns = 0.0;
+            for (long long done = 0; done < k; done += roundLength) {
+                long long count = std::min(roundLength, k - done);
+                auto start = Clock::now();
+                for (long long n = 0; n < count; ++n) {
+                    sink = doMonsterAttack(map, size, size, player, pillars);
+                }
+                ns += elapsedNs(start);
+                // restore the player's row and column, and their monster counts
+                for (int i = 0; i < size; ++i) {
+                    pillars.retile(i, player.col, map[i][player.col], savedCol[i]);
+                    map[i][player.col] = savedCol[i];
+                }
+                for (int j = 0; j < size; ++j) {
+                    pillars.retile(player.row, j, map[player.row][j], savedRow[j]);
+                    map[player.row][j] = savedRow[j];
+                }
+            }
+            return ns;
+        }, 1LL << 30);
+        (void)sink;
+        result.tilesPerOp = 2.0 * size;
+        result.mapBytes = 1.0 * size * (size + sizeof(char*)) + pillars.bytes();
+        results.push_back(result);
+    }
+    pillars.release();
+    deleteMap(map, size);
+}
+
+/**
+ * Time building the entity store and monster turns that keep it up to date, on the
+ * same levels as doMonsterAttack. Levels with monsters are restored, store and all,
+ * every few turns. entityQuietAttack clears the player's row and column of monsters,
+ * so every turn after the first is known to move nothing.
+ * @return None
+ * @update results
+ */
+void benchEntityStore(const BenchConfig& config, int size, double density, vector<BenchResult>& results) {
+    Player player;
+    char** map = makeLevel(size, size, density, player);
+    EntityStore entities;
+
+    if (selected(config, "entityStoreBuild")) {
+        BenchResult result = newResult("entityStoreBuild", size, density);
+        sample(config, result, [&](long long k) {
+            auto start = Clock::now();
+            for (long long n = 0; n < k; ++n) {
+                entities.build(map, size, size);
+            }
+            return elapsedNs(start);
+        }, batchLimit(1LL * size * size));
+        result.tilesPerOp = 1.0 * size * size;
+        results.push_back(result);
+    }
+
+    if (selected(config, "entityMonsterAttack") && entities.build(map, size, size)) {
+        BenchResult result = newResult("entityMonsterAttack", size, density);
+        vector<char> savedRow(map[player.row], map[player.row] + size);
+        vector<char> savedCol(size);
+        for (int i = 0; i < size; ++i) {
+            savedCol[i] = map[i][player.col];
+        }
+        const long long roundLength = 16;
+
+        volatile bool sink = false;
+        sample(config, result, [&](long long k) {
+            double ns = 0.0;
+            for (long long done = 0; done < k; done += roundLength) {
+                long long count = std::min(roundLength, k - done);
+                auto start = Clock::now();
+                for (long long n = 0; n < count; ++n) {
+                    sink = doMonsterAttack(map, size, size, player, entities);
+                }
+                ns += elapsedNs(start);
+                if (entities.count(TILE_MONSTER) == 0) {
+                    continue;
+                }
+                for (int i = 0; i < size; ++i) {
+                    map[i][player.col] = savedCol[i];
+                }
+                std::copy(savedRow.begin(), savedRow.end(), map[player.row]);
+                entities.build(map, size, size);
+            }
+            return ns;
+        }, batchLimit(1LL * size * size));
+        (void)sink;
+        result.tilesPerOp = 2.0 * size;
+        result.mapBytes = 1.0 * size * (size + sizeof(char*)) + entities.bytes();
+        results.push_back(result);
+    }
+
+    if (selected(config, "entityQuietAttack")) {
+        for (int i = 0; i < size; ++i) {
+            map[i][player.col] = map[i][player.col] == TILE_MONSTER ? TILE_OPEN : map[i][player.col];
+            map[player.row][i] = map[player.row][i] == TILE_MONSTER ? TILE_OPEN : map[player.row][i];
+        }
+        if (entities.build(map, size, size)) {
+            BenchResult result = newResult("entityQuietAttack", size, density);
+            volatile bool sink = false;
+            sample(config, result, [&](long long k) {
+                auto start = Clock::now();
+                for (long long n = 0; n < k; ++n) {
+                    sink = doMonsterAttack(map, size, size, player, entities);
+                }
+                return elapsedNs(start);
+            }, 1LL << 30);
+            (void)sink;
+            result.tilesPerOp = 2.0 * size;
+            result.mapBytes = 1.0 * size * (size + sizeof(char*)) + entities.bytes();
+            results.push_back(result);
+        }
+    }
+    entities.release();
+    deleteMap(map, size);
+}
+
+/**
+ * Time flow-field monster turns on the same levels as doMonsterAttack: flowFieldChase
+ * moves the player every turn, so the field is searched again, and flowFieldStay keeps
+ * it in place, so only the monsters move. flowFieldSwarm moves the player as
+ * flowFieldChase does but steps all monsters at once, on --threads threads. Levels with
+ * monsters are restored, field and all, every few turns. flowFieldHint moves the player
+ * and asks for one distance.
+ * @return None
+ * @update results
+ */
+void benchFlowField(const BenchConfig& config, int size, double density, vector<BenchResult>& results) {
+    Player player;
+    char** map = makeLevel(size, size, density, player);
+    vector<char> saved(static_cast<std::size_t>(size) * size);
+    for (int i = 0; i < size; ++i) {
+        std::copy(map[i], map[i] + size, saved.begin() + static_cast<std::size_t>(i) * size);
+    }
+    FlowField flow;
+    const long long roundLength = 16;
+
+    for (const char* name : {"flowFieldChase", "flowFieldStay", "flowFieldSwarm"}) {
+        bool moving = name != string("flowFieldStay");
+        bool swarm = name == string("flowFieldSwarm");
+        if (!selected(config, name) || !flow.build(map, size, size)) {
+            continue;
+        }
+        BenchResult result = newResult(name, size, density);
+        Player turnPlayer = player;
+        flow.update(turnPlayer);
+        volatile bool sink = false;
+        sample(config, result, [&](long long k) {
+            double ns = 0.0;
+            for (long long done = 0; done < k; done += roundLength) {
+                long long count = std::min(roundLength, k - done);
+                auto start = Clock::now();
+                for (long long n = 0; n < count; ++n) {
+                    // step between the player's tile and the open tile to its right
+                    if (moving) {
+                        turnPlayer.col = turnPlayer.col == player.col ? player.col + 1 : player.col;
+                    }
+                    sink = swarm ? doMonsterSwarm(map, size, size, turnPlayer, flow)
+                                 : doMonsterChase(map, size, size, turnPlayer, flow);
+                }
+                ns += elapsedNs(start);
+                if (flow.monsterCount() == 0) {
+                    continue;
+                }
+                for (int i = 0; i < size; ++i) {
+                    std::copy(saved.begin() + static_cast<std::size_t>(i) * size,
+                              saved.begin() + static_cast<std::size_t>(i + 1) * size, map[i]);
+                }
+                flow.build(map, size, size);
+                flow.update(turnPlayer);
+            }
+            return ns;
+        }, batchLimit(1LL * size * size));
+        (void)sink;
+        result.tilesPerOp = 1.0 * size * size;
+        result.mapBytes = 1.0 * size * (size + sizeof(char*)) + flow.bytes();
+        results.push_back(result);
+    }
+
+    // a player move and one distance query a few tiles away, as for a hint
+    if (selected(config, "flowFieldHint") && flow.build(map, size, size)) {
+        BenchResult result = newResult("flowFieldHint", size, density);
+        Player turnPlayer = player;
+        int hintRow = std::max(0, player.row - 16);
+        volatile std::uint32_t sink = 0;
+        sample(config, result, [&](long long k) {
+            auto start = Clock::now();
+            for (long long n = 0; n < k; ++n) {
+                turnPlayer.col = turnPlayer.col == player.col ? player.col + 1 : player.col;
+                flow.follow(turnPlayer);
+                sink = flow.distance(hintRow, player.col);
+            }
+            return elapsedNs(start);
+        }, 1LL << 30);
+        (void)sink;
+        result.tilesPerOp = flow.settled();
+        result.mapBytes = 1.0 * size * (size + sizeof(char*)) + flow.bytes();
+        results.push_back(result);
+    }
+    flow.release();
+    deleteMap(map, size);
+}
+
+/**
+ * Play the same random moves and monster turns on a layout and on the char** game,
+ * and check that both end in the same state.
+ * @param   layout      Map under test, holding the same tiles as map.
+ * @param   map         char** copy of the level.
+ * @param   size        Number of rows and columns.
+ * @param   player      Player starting position.
+ * @return  true if every tile and status matched.
+ */
+template <class Map>
+bool matchesGame(Map& layout, char** map, int size, const Player& player) {
+    Player a = player;
+    Player b = player;
+    std::mt19937 rng(size);
+    const char moves[] = {MOVE_UP, MOVE_LEFT, MOVE_DOWN, MOVE_RIGHT};
+    for (int turn = 0; turn < 64; ++turn) {
+        int nextRow = a.row;
+        int nextCol = a.col;
+        getDirection(moves[rng() % 4], nextRow, nextCol);
+        if (movePlayer(layout, a, nextRow, nextCol) != doPlayerMove(map, size, size, b, nextRow, nextCol) ||
+            monsterAttack(layout, a) != doMonsterAttack(map, size, size, b)) {
+            return false;
+        }
+    }
+    for (int i = 0; i < size; ++i) {
+        for (int j = 0; j < size; ++j) {
+            if (layout.get(i, j) != map[i][j]) {
+                return false;
+            }
+        }
+    }
+    return a.row == b.row && a.col == b.col && a.treasure == b.treasure;
+}
+
+/**
+ * Time movePlayer on a map layout, stepping right and back like benchPlayerMove.
+ * @param   function    Name the result is reported under.
+ * @param   layout      Map holding a level from makeLevel.
+ * @param   player      Player position in the level.
+ * @return None
+ * @update results
+ */
+template <class Map>
+void benchLayoutPlayerMove(const BenchConfig& config, const string& function, Map& layout, Player player,
+                           int size, vector<BenchResult>& results) {
+    BenchResult result = newResult(function, size, 0.0);
+    int homeCol = player.col;
+    volatile int sink = 0;
+    sample(config, result, [&](long long k) {
+        auto start = Clock::now();
+        for (long long n = 0; n < k; ++n) {
+            int nextCol = (player.col == homeCol) ? homeCol + 1 : homeCol;
+            sink = sink + movePlayer(layout, player, player.row, nextCol);
+        }
+        return elapsedNs(start);
+    }, 1LL << 30);
+    result.tilesPerOp = 1;
+    results.push_back(result);
+}
+
+/**
+ * Time monsterAttack on a map layout, restoring the player's row and column between
+ * rounds like benchMonsterAttack.
+ * @param   function    Name the result is reported under.
+ * @param   layout      Map holding a level from makeLevel.
+ * @param   player      Player position in the level.
+ * @return None
+ * @update results
+ */
+template <class Map>
+void benchLayoutMonsterAttack(const BenchConfig& config, const string& function, Map& layout,
+                              const Player& player, int size, double density, vector<BenchResult>& results) {
+    BenchResult result = newResult(function, size, density);
+    vector<char> savedRow(size);
+    vector<char> savedCol(size);
+    for (int i = 0; i < size; ++i) {
+        savedRow[i] = layout.get(player.row, i);
+        savedCol[i] = layout.get(i, player.col);
+    }
+    const long long roundLength = 16;
+
+    volatile bool sink = false;
+    sample(config, result, [&](long long k) {
+        double ns = 0.0;
+        for (long long done = 0; done < k; done += roundLength) {
+            long long count = std::min(roundLength, k - done);
+            auto start = Clock::now();
+            for (long long n = 0; n < count; ++n) {
+                sink = monsterAttack(layout, player);
+            }
+            ns += elapsedNs(start);
+            for (int i = 0; i < size; ++i) {
+                layout.set(i, player.col, savedCol[i]);
+            }
+            for (int i = 0; i < size; ++i) {
+                layout.set(player.row, i, savedRow[i]);
+            }
+        }
+        return ns;
+    }, 1LL << 30);
+    (void)sink;
+    result.tilesPerOp = 2.0 * size;
+    results.push_back(result);
+}
+
+/**
+ * Benchmark the compile-time Room specialization for this size, if there is one.
+ * Reported as roomPlayerMove and roomMonsterAttack next to the char** functions.
+ * @return None
+ * @update results
+ */
+void benchRoom(const BenchConfig& config, int size, double density, vector<BenchResult>& results) {
+    Player player;
+    char** map = makeLevel(size, size, density, player);
+    dispatchRoom(size, size, [&](auto fixed) {
+        using FixedRoom = typename decltype(fixed)::type;
+        FixedRoom room;
+        room.load(map);
+        if (!matchesGame(room, map, size, player)) {
+            cerr << "Error: Room<" << size << ", " << size << "> does not match the game" << endl;
+            return;
+        }
+        deleteMap(map, size);
+        map = makeLevel(size, size, density, player);
+        room.load(map);
+        if (density == config.densities.front() && selected(config, "roomPlayerMove")) {
+            benchLayoutPlayerMove(config, "roomPlayerMove", room, player, size, results);
+            room.load(map);
+        }
+        if (selected(config, "roomMonsterAttack")) {
+            benchLayoutMonsterAttack(config, "roomMonsterAttack", room, player, size, density, results);
+        }
+    });
+    deleteMap(map, size);
+}
+
+/**
+ * Benchmark the 4-bit packed map at this size, after checking that it plays and
+ * renders exactly like the char** map.
+ * Reported as packedMonsterAttack and packedOutputMap.
+ * @return None
+ * @update results
+ */
+void benchPacked(const BenchConfig& config, int size, double density, vector<BenchResult>& results) {
+    Player player;
+    char** map = makeLevel(size, size, density, player);
+    PackedMap packed;
+    bool loaded = packed.load(map, size, size);
+
+    std::ostringstream expected;
+    std::ostringstream actual;
+    std::streambuf* saved = cout.rdbuf(expected.rdbuf());
+    outputMap(map, size, size);
+    cout.rdbuf(actual.rdbuf());
+    outputPackedMap(packed);
+    cout.rdbuf(saved);
+
+    if (!loaded || expected.str() != actual.str() || !matchesGame(packed, map, size, player)) {
+        cerr << "Error: packed " << size << "x" << size << " map does not match the game" << endl;
+        deleteMap(map, size);
+        return;
+    }
+    deleteMap(map, size);
+    map = makeLevel(size, size, density, player);
+    packed.load(map, size, size);
+    deleteMap(map, size);
+
+    if (selected(config, "packedMonsterAttack")) {
+        benchLayoutMonsterAttack(config, "packedMonsterAttack", packed, player, size, density, results);
+        results.back().mapBytes = packed.bytes();
+    }
+    if (selected(config, "packedOutputMap")) {
+        BenchResult result = newResult("packedOutputMap", size, density);
+        NullBuffer sink;
+        saved = cout.rdbuf(&sink);
+        sample(config, result, [&](long long k) {
+            auto start = Clock::now();
+            for (long long n = 0; n < k; ++n) {
+                outputPackedMap(packed);
+            }
+            return elapsedNs(start);
+        }, 1LL << 30);
+        cout.rdbuf(saved);
+        result.tilesPerOp = 1.0 * size * size;
+        results.push_back(result);
+    }
+}
+
+/**
+ * Benchmark the run-length-encoded map at this size, after checking that it plays
+ * like the char** map. Reported as rleMonsterAttack.
+ * @return None
+ * @update results
+ */
+void benchRle(const BenchConfig& config, int size, double density, vector<BenchResult>& results) {
+    Player player;
+    char** map = makeLevel(size, size, density, player);
+    RleMap rle;
+    if (!rle.load(map, size, size) || !matchesGame(rle, map, size, player)) {
+        cerr << "Error: RLE " << size << "x" << size << " map does not match the game" << endl;
+        deleteMap(map, size);
+        return;
+    }
+    deleteMap(map, size);
+    map = makeLevel(size, size, density, player);
+    rle.load(map, size, size);
+    deleteMap(map, size);
+
+    benchLayoutMonsterAttack(config, "rleMonsterAttack", rle, player, size, density, results);
+    results.back().mapBytes = rle.bytes();
+}
+
+/**
+ * Benchmark the sparse hash map at this size, after checking that it plays like the
+ * char** map. Reported as sparseMonsterAttack.
+ * @return None
+ * @update results
+ */
+void benchSparse(const BenchConfig& config, int size, double density, vector<BenchResult>& results) {
+    Player player;
+    char** map = makeLevel(size, size, density, player);
+    SparseMap sparse;
+    if (!sparse.load(map, size, size) || !matchesGame(sparse, map, size, player)) {
+        cerr << "Error: sparse " << size << "x" << size << " map does not match the game" << endl;
+        deleteMap(map, size);
+        return;
+    }
+    deleteMap(map, size);
+    map = makeLevel(size, size, density, player);
+    sparse.load(map, size, size);
+    deleteMap(map, size);
+
+    benchLayoutMonsterAttack(config, "sparseMonsterAttack", sparse, player, size, density, results);
+    results.back().mapBytes = sparse.bytes();
+}
+
+// chunk cache given to the out-of-core map benchmark
+const std::uint64_t BENCH_CHUNK_CACHE = 64 * CHUNK_BYTES;
+
+/**
+ * Benchmark the disk-backed chunked map at this size with a BENCH_CHUNK_CACHE cache,
+ * after checking that it plays like the char** map. Reported as chunkedMonsterAttack.
+ * @return None
+ * @update results
+ */
+void benchChunked(const BenchConfig& config, int size, double density, vector<BenchResult>& results) {
+    Player player;
+    char** map = makeLevel(size, size, density, player);
+    std::ostringstream name;
+    name << "bench_chunked_" << size << "_" << density;
+    string levelFile = name.str() + ".txt";
+    string chunkFile = name.str() + ".chunks";
+    bool written = writeLevel(levelFile, map, size, size, player) && createChunkFile(levelFile, chunkFile);
+    std::remove(levelFile.c_str());
+
+    ChunkedMap chunked;
+    Player start;
+    if (!written || !chunked.open(chunkFile, BENCH_CHUNK_CACHE, start) ||
+        !matchesGame(chunked, map, size, player)) {
+        cerr << "Error: chunked " << size << "x" << size << " map does not match the game" << endl;
+    } else {
+        // rebuild the chunk file so timing starts from the unplayed level
+        chunked.close();
+        deleteMap(map, size);
+        map = makeLevel(size, size, density, player);
+        writeLevel(levelFile, map, size, size, player);
+        createChunkFile(levelFile, chunkFile);
+        std::remove(levelFile.c_str());
+        chunked.open(chunkFile, BENCH_CHUNK_CACHE, start);
+        benchLayoutMonsterAttack(config, "chunkedMonsterAttack", chunked, start, size, density, results);
+        results.back().mapBytes = chunked.bytes();
+        chunked.close();
+    }
+    deleteMap(map, size);
+    std::remove(chunkFile.c_str());
+}
+
+/**
+ * Time row scans, column scans, 3x3 neighbourhood reads and monster turns on one
+ * map layout. Results are named prefix + RowScan, ColumnScan, Neighborhood and
+ * MonsterAttack.
+ * @param   prefix      Layout name.
+ * @param   layout      Map holding a level from makeLevel.
+ * @param   player      Player position in the level.
+ * @return None
+ * @update results
+ */
+template <class Map>
+void benchLayoutAccess(const BenchConfig& config, const string& prefix, Map& layout, const Player& player,
+                       int size, vector<BenchResult>& results) {
+    volatile long long sink = 0;
+    if (selected(config, prefix + "RowScan")) {
+        BenchResult result = newResult(prefix + "RowScan", size, 0.0);
+        int row = 0;
+        sample(config, result, [&](long long k) {
+            long long monsters = 0;
+            auto start = Clock::now();
+            for (long long n = 0; n < k; ++n) {
+                row = (row + 7919) % size;
+                for (int j = 0; j < size; ++j) {
+                    monsters += layout.get(row, j) == TILE_MONSTER;
+                }
+            }
+            sink = sink + monsters;
+            return elapsedNs(start);
+        }, 1LL << 30);
+        result.tilesPerOp = size;
+        results.push_back(result);
+    }
+    if (selected(config, prefix + "ColumnScan")) {
+        BenchResult result = newResult(prefix + "ColumnScan", size, 0.0);
+        int col = 0;
+        sample(config, result, [&](long long k) {
+            long long monsters = 0;
+            auto start = Clock::now();
+            for (long long n = 0; n < k; ++n) {
+                col = (col + 7919) % size;
+                for (int i = 0; i < size; ++i) {
+                    monsters += layout.get(i, col) == TILE_MONSTER;
+                }
+            }
+            sink = sink + monsters;
+            return elapsedNs(start);
+        }, 1LL << 30);
+        result.tilesPerOp = size;
+        results.push_back(result);
+    }
+    if (selected(config, prefix + "Neighborhood")) {
+        BenchResult result = newResult(prefix + "Neighborhood", size, 0.0);
+        std::uint32_t state = 12345;
+        sample(config, result, [&](long long k) {
+            long long monsters = 0;
+            auto start = Clock::now();
+            for (long long n = 0; n < k; ++n) {
+                state = state * 1664525u + 1013904223u;
+                int row = 1 + static_cast<int>((state >> 8) % (size - 2));
+                int col = 1 + static_cast<int>((state * 31u >> 8) % (size - 2));
+                for (int i = row - 1; i <= row + 1; ++i) {
+                    for (int j = col - 1; j <= col + 1; ++j) {
+                        monsters += layout.get(i, j) == TILE_MONSTER;
+                    }
+                }
+            }
+            sink = sink + monsters;
+            return elapsedNs(start);
+        }, 1LL << 30);
+        result.tilesPerOp = 9;
+        results.push_back(result);
+    }
+    if (selected(config, prefix + "MonsterAttack")) {
+        benchLayoutMonsterAttack(config, prefix + "MonsterAttack", layout, player, size, 0.0, results);
+    }
+    (void)sink;
+}
+
+/**
+ * Compare row-major (char**), 8x8 blocked and Morton-ordered block layouts.
+ * @return None
+ * @update results
+ */
+void benchTiled(const BenchConfig& config, int size, vector<BenchResult>& results) {
+    bool wanted = false;
+    for (const char* layout : {"rowMajor", "blocked", "morton"}) {
+        for (const char* access : {"RowScan", "ColumnScan", "Neighborhood", "MonsterAttack"}) {
+            wanted = wanted || selected(config, string(layout) + access);
+        }
+    }
+    if (!wanted) {
+        return;
+    }
+
+    Player player;
+    char** map = makeLevel(size, size, 0.1, player);
+    Player start = player;
+    CharMap rowMajor{map, size, size};
+    benchLayoutAccess(config, "rowMajor", rowMajor, start, size, results);
+    deleteMap(map, size);
+
+    const TileOrder orders[] = {TILE_ORDER_BLOCKED, TILE_ORDER_MORTON};
+    const char* names[] = {"blocked", "morton"};
+    for (int k = 0; k < 2; ++k) {
+        map = makeLevel(size, size, 0.1, player);
+        TiledMap tiled;
+        bool loaded = tiled.load(map, size, size, orders[k]);
+        if (!loaded || !matchesGame(tiled, map, size, player)) {
+            cerr << "Error: " << names[k] << " " << size << "x" << size << " map does not match the game" << endl;
+            deleteMap(map, size);
+            continue;
+        }
+        tiled.load(map, size, size, orders[k]);
+        deleteMap(map, size);
+        size_t first = results.size();
+        benchLayoutAccess(config, names[k], tiled, start, size, results);
+        for (size_t i = first; i < results.size(); ++i) {
+            results[i].mapBytes = tiled.bytes();
+        }
+    }
+}
+
+/**
+ * Count dTLB read misses over one scan of every column of a map.
+ * @param   map         Map to scan.
+ * @param   size        Side length of the map.
+ * @return  misses per column scan, or -1 without DUNGEON_PERF or when the counter is unavailable.
+ */
+double columnScanTlbMisses(char** map, int size) {
+#ifdef DUNGEON_PERF
+    if (!perfAvailable(PERF_DTLB_MISSES)) {
+        return -1.0;
+    }
+    volatile long long sink = 0;
+    long long monsters = 0;
+    PerfSample before;
+    PerfSample after;
+    perfRead(before);
+    for (int j = 0; j < size; ++j) {
+        for (int i = 0; i < size; ++i) {
+            monsters += map[i][j] == TILE_MONSTER;
+        }
+    }
+    perfRead(after);
+    sink = monsters;
+    (void)sink;
+    return 1.0 * (after.values[PERF_DTLB_MISSES] - before.values[PERF_DTLB_MISSES]) / size;
+#else
+    (void)map;
+    (void)size;
+    return -1.0;
+#endif
+}
+
+/**
+ * Compare the access benchmarks on char** maps mapped with small pages and with
+ * transparent huge pages. Results are named smallPages and hugePages + the access.
+ * @return None
+ * @update results
+ */
+void benchPageSizes(const BenchConfig& config, int size, vector<BenchResult>& results) {
+    const MapPagePolicy policies[] = {MAP_PAGES_SMALL, MAP_PAGES_THP};
+    const char* names[] = {"smallPages", "hugePages"};
+    MapPagePolicy saved = mapPagePolicy();
+    for (int k = 0; k < 2; ++k) {
+        bool wanted = false;
+        for (const char* access : {"RowScan", "ColumnScan", "Neighborhood", "MonsterAttack"}) {
+            wanted = wanted || selected(config, string(names[k]) + access);
+        }
+        if (!wanted) {
+            continue;
+        }
+        setMapPagePolicy(policies[k]);
+        Player player;
+        char** map = makeLevel(size, size, 0.1, player);
+        setMapPagePolicy(saved);
+
+        CharMap layout{map, size, size};
+        size_t first = results.size();
+        benchLayoutAccess(config, names[k], layout, player, size, results);
+        double hugeBytes = static_cast<double>(mapHugePageBytes(map[0]));
+        double tlbMisses = columnScanTlbMisses(map, size);
+        for (size_t i = first; i < results.size(); ++i) {
+            results[i].mapBytes = 1.0 * size * (size + sizeof(char*));
+            results[i].hugePageBytes = hugeBytes;
+            if (results[i].function == string(names[k]) + "ColumnScan") {
+                results[i].tlbMissesPerOp = tlbMisses;
+            }
+        }
+        deleteMap(map, size);
+    }
+}
+
+void benchOutputMap(const BenchConfig& config, int size, double density, vector<BenchResult>& results) {
+    BenchResult result = newResult("outputMap", size, density);
+    Player player;
+    char** map = makeLevel(size, size, density, player);
+    NullBuffer sink;
+    std::streambuf* saved = cout.rdbuf(&sink);
+    sample(config, result, [&](long long k) {
+        auto start = Clock::now();
+        for (long long n = 0; n < k; ++n) {
+            outputMap(map, size, size);
+        }
+        return elapsedNs(start);
+    }, 1LL << 30);
+    cout.rdbuf(saved);
+    result.tilesPerOp = 1.0 * size * size;
+    results.push_back(result);
+    deleteMap(map, size);
+}
+
+void benchLoadLevel(const BenchConfig& config, int size, double density, vector<BenchResult>& results) {
+    BenchResult result = newResult("loadLevel", size, density);
+    Player player;
+    char** map = makeLevel(size, size, density, player);
+    std::ostringstream name;
+    name << "bench_level_" << size << "_" << density << ".txt";
+    string fileName = name.str();
+    bool written = writeLevel(fileName, map, size, size, player);
+    deleteMap(map, size);
+    if (!written) {
+        cerr << "Error: unable to write " << fileName << endl;
+        return;
+    }
+
+    long long tiles = 1LL * size * size;
+    sample(config, result, [&](long long k) {
+        vector<char**> maps(k);
+        auto start = Clock::now();
+        for (char**& loaded : maps) {
+            int rows = 0;
+            int cols = 0;
+            loaded = loadLevel(fileName, rows, cols, player);
+        }
+        double ns = elapsedNs(start);
+        for (char**& loaded : maps) {
+            int rows = size;
+            deleteMap(loaded, rows);
+        }
+        return ns;
+    }, batchLimit(tiles));
+    result.tilesPerOp = tiles;
+    results.push_back(result);
+    std::remove(fileName.c_str());
+}
+
+/**
+ * Fit ns/op = coefficient * f(N) for each candidate curve and keep the best one,
+ * where N is the tile count. The RMS error is normalized by the mean time.
+ * @param   results     All measurements.
+ * @param   function    Function name to fit.
+ * @param   density     Monster density to fit.
+ * @param   fit         Best fitting curve.
+ * @return  true if at least two sizes were measured.
+ * @update  fit
+ */
+bool fitComplexity(const vector<BenchResult>& results, const string& function, double density, ComplexityFit& fit) {
+    vector<double> n;
+    vector<double> t;
+    for (const BenchResult& result : results) {
+        if (result.function == function && result.density == density) {
+            n.push_back(1.0 * result.rows * result.cols);
+            t.push_back(result.nsPerOp);
+        }
+    }
+    if (n.size() < 2) {
+        return false;
+    }
+
+    struct Curve {
+        const char* name;
+        double (*f)(double);
+    };
+    const Curve curves[] = {
+        {"O(1)",       [](double) { return 1.0; }},
+        {"O(sqrt(N))", [](double x) { return std::sqrt(x); }},
+        {"O(N)",       [](double x) { return x; }},
+        {"O(N log N)", [](double x) { return x * std::log2(x); }},
+        {"O(N^2)",     [](double x) { return x * x; }},
+    };
+
+    double mean = 0.0;
+    for (double value : t) {
+        mean += value;
+    }
+    mean /= t.size();
+
+    bool first = true;
+    for (const Curve& curve : curves) {
+        double ft = 0.0;
+        double ff = 0.0;
+        for (size_t i = 0; i < n.size(); ++i) {
+            ft += curve.f(n[i]) * t[i];
+            ff += curve.f(n[i]) * curve.f(n[i]);
+        }
+        double coefficient = ft / ff;
+        double error = 0.0;
+        for (size_t i = 0; i < n.size(); ++i) {
+            double diff = t[i] - coefficient * curve.f(n[i]);
+            error += diff * diff;
+        }
+        double rms = std::sqrt(error / n.size()) / mean;
+        if (first || rms < fit.rms) {
+            fit = ComplexityFit{function, density, curve.name, coefficient, rms};
+            first = false;
+        }
+    }
+    return true;
+}
+
+void writeJson(std::ostream& out, const BenchConfig& config, const vector<BenchResult>& results,
+               const vector<ComplexityFit>& fits) {
+    out.precision(6);
+    out << "{\n";
+    out << "  \"context\": {\n";
+    out << "    \"min_size\": " << config.minSize << ",\n";
+    out << "    \"max_size\": " << config.maxSize << ",\n";
+    out << "    \"min_time_ms\": " << config.minTimeMs << ",\n";
+    out << "    \"repetitions\": " << config.repetitions << ",\n";
+    out << "    \"compiler\": \"" << __VERSION__ << "\"\n";
+    out << "  },\n";
+    out << "  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& r = results[i];
+        out << "    {\"function\": \"" << r.function << "\", \"rows\": " << r.rows
+            << ", \"cols\": " << r.cols << ", \"density\": " << r.density
+            << ", \"iterations\": " << r.iterations << ", \"ns_per_op\": " << r.nsPerOp;
+        double low, high;
+        medianInterval(r.samples, low, high);
+        out << ", \"repetitions\": " << r.samples.size() << ", \"ci_low\": " << low
+            << ", \"ci_high\": " << high
+            << ", \"tiles_per_second\": " << r.tilesPerOp * 1e9 / r.nsPerOp;
+        if (r.mapBytes > 0.0) {
+            out << ", \"map_bytes\": " << r.mapBytes;
+        }
+        if (r.hugePageBytes >= 0.0) {
+            out << ", \"huge_page_bytes\": " << r.hugePageBytes;
+        }
+        if (r.tlbMissesPerOp >= 0.0) {
+            out << ", \"dtlb_misses_per_op\": " << r.tlbMissesPerOp;
+        }
+        out << "}"
+            << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ],\n";
+    out << "  \"complexity\": [\n";
+    for (size_t i = 0; i < fits.size(); ++i) {
+        const ComplexityFit& f = fits[i];
+        out << "    {\"function\": \"" << f.function << "\", \"density\": " << f.density
+            << ", \"big_o\": \"" << f.bigO << "\", \"coefficient\": " << f.coefficient
+            << ", \"rms\": " << f.rms << "}" << (i + 1 < fits.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n";
+    out << "}\n";
+}
+
+vector<string> split(const string& text) {
+    vector<string> items;
+    std::istringstream iss(text);
+    string item;
+    while (std::getline(iss, item, ',')) {
+        items.push_back(item);
+    }
+    return items;
+}
+
+vector<double> parseList(const string& text) {
+    vector<double> values;
+    for (const string& item : split(text)) {
+        values.push_back(std::atof(item.c_str()));
+    }
+    return values;
+}
+
+bool parseArgs(int argc, char** argv, BenchConfig& config) {
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (i + 1 >= argc) {
+            cerr << "Error: missing value for " << arg << endl;
+            return false;
+        }
+        string value = argv[++i];
+        if (arg == "--min-size") {
+            config.minSize = std::atoi(value.c_str());
+        } else if (arg == "--max-size") {
+            config.maxSize = std::atoi(value.c_str());
+        } else if (arg == "--densities") {
+            config.densities = parseList(value);
+        } else if (arg == "--min-time") {
+            config.minTimeMs = std::atof(value.c_str());
+        } else if (arg == "--repetitions") {
+            config.repetitions = std::atoi(value.c_str());
+        } else if (arg == "--functions") {
+            config.functions = split(value);
+        } else if (arg == "--out") {
+            config.outFile = value;
+        } else if (arg == "--save-baseline") {
+            config.saveBaselineFile = value;
+        } else if (arg == "--compare") {
+            config.compareFile = value;
+        } else if (arg == "--threshold") {
+            config.threshold = std::atof(value.c_str()) / 100.0;
+        } else if (arg == "--gate") {
+            config.gated = split(value);
+        } else if (arg == "--threads") {
+            config.threads = static_cast<unsigned>(std::atoi(value.c_str()));
+        } else {
+            cerr << "Error: unknown option " << arg << endl;
+            return false;
+        }
+    }
+    return config.minSize >= 4 && config.maxSize >= config.minSize && config.repetitions >= 1;
+}
+
+vector<BaselineEntry> toBaseline(const vector<BenchResult>& results) {
+    vector<BaselineEntry> entries;
+    for (const BenchResult& result : results) {
+        entries.push_back(BaselineEntry{result.function, result.rows, result.cols, result.density, result.samples});
+    }
+    return entries;
+}
+
+int main(int argc, char** argv) {
+    BenchConfig config;
+    if (!parseArgs(argc, argv, config)) {
+        cerr << "Usage: " << argv[0] << " [--min-size N] [--max-size N] [--densities a,b,...]"
+             << " [--min-time MS] [--repetitions N] [--functions f,g,...] [--out FILE]"
+             << " [--save-baseline FILE] [--compare FILE] [--threshold PCT] [--gate f,g,...]"
+             << " [--threads N]" << endl;
+        return 1;
+    }
+    setMapThreads(config.threads);
+
+    // read the baseline up front so a bad path fails before the long run
+    vector<BaselineEntry> baseline;
+    if (!config.compareFile.empty() && !loadBaseline(config.compareFile, baseline)) {
+        return 1;
+    }
+
+    vector<BenchResult> results;
+    for (int size = config.minSize; size <= config.maxSize; size *= 2) {
+        cerr << "size " << size << "x" << size << endl;
+        if (selected(config, "createMap")) {
+            benchCreateMap(config, size, results);
+        }
+        if (selected(config, "deleteMap")) {
+            benchDeleteMap(config, size, results);
+        }
+        if (selected(config, "doPlayerMove")) {
+            benchPlayerMove(config, size, results);
+        }
+        // resizeMap doubles the map, so keep its output within --max-size
+        if (selected(config, "resizeMap") && 2 * size <= config.maxSize) {
+            benchResizeMap(config, size, results);
+        }
+        benchTiled(config, size, results);
+        benchPageSizes(config, size, results);
+        for (double density : config.densities) {
+            if (selected(config, "doMonsterAttack")) {
+                benchMonsterAttack(config, size, density, results);
+            }
+            if (selected(config, "pillarIndexBuild") || selected(config, "indexedMonsterAttack")) {
+                benchPillarIndex(config, size, density, results);
+            }
+            if (selected(config, "entityStoreBuild") || selected(config, "entityMonsterAttack") ||
+                selected(config, "entityQuietAttack")) {
+                benchEntityStore(config, size, density, results);
+            }
+            if (selected(config, "flowFieldChase") || selected(config, "flowFieldStay") ||
+                selected(config, "flowFieldSwarm") || selected(config, "flowFieldHint")) {
+                benchFlowField(config, size, density, results);
+            }
+            if (selected(config, "outputMap")) {
+                benchOutputMap(config, size, density, results);
+            }
+            if (selected(config, "loadLevel")) {
+                benchLoadLevel(config, size, density, results);
+            }
+            if (selected(config, "roomPlayerMove") || selected(config, "roomMonsterAttack")) {
+                benchRoom(config, size, density, results);
+            }
+            if (selected(config, "packedMonsterAttack") || selected(config, "packedOutputMap")) {
+                benchPacked(config, size, density, results);
+            }
+            if (selected(config, "rleMonsterAttack")) {
+                benchRle(config, size, density, results);
+            }
+            if (selected(config, "sparseMonsterAttack")) {
+                benchSparse(config, size, density, results);
+            }
+            if (selected(config, "chunkedMonsterAttack")) {
+                benchChunked(config, size, density, results);
+            }
+        }
+    }
+
+    // fit every (function, density) pair that was measured, in the order first seen
+    vector<ComplexityFit> fits;
+    vector<std::pair<string, double>> series;
+    for (const BenchResult& result : results) {
+        std::pair<string, double> key(result.function, result.density);
+        if (std::find(series.begin(), series.end(), key) == series.end()) {
+            series.push_back(key);
+        }
+    }
+    for (const auto& [function, density] : series) {
+        ComplexityFit fit;
+        if (fitComplexity(results, function, density, fit)) {
+            fits.push_back(fit);
+        }
+    }
+
+    if (config.outFile.empty()) {
+        writeJson(cout, config, results, fits);
+    } else {
+        ofstream ofs(config.outFile);
+        if (!ofs.is_open()) {
+            cerr << "Error: File unable to open: " << config.outFile << endl;
+            return 1;
+        }
+        writeJson(ofs, config, results, fits);
+    }
+
+    if (!config.saveBaselineFile.empty() && !saveBaseline(config.saveBaselineFile, toBaseline(results))) {
+        return 1;
+    }
+
+    if (!config.compareFile.empty()) {
+        int regressions = compareBaseline(baseline, toBaseline(results), config.gated,
+                                          config.threshold, DEFAULT_REGRESSION_ALPHA, cerr);
+        if (regressions > 0) {
+            cerr << "FAILED: " << regressions << " benchmark(s) regressed or could not be tested against "
+                 << config.compareFile << endl;
+            return 2;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,292 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include "chunkedmap.h"
+#include "helper.h"
+#include "profile.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+const char CHUNK_MAGIC[8] = {'D', 'C', 'H', 'U', 'N', 'K', '1', '\n'};
+
+// magic, then rows, columns, player row and player column as 64-bit integers
+struct ChunkFileHeader {
+    char magic[8];
+    std::int64_t rows;
+    std::int64_t cols;
+    std::int64_t playerRow;
+    std::int64_t playerCol;
+};
+
+/**
+ * Read exactly bytes at offset, retrying short reads.
+ * @return  number of bytes read; fewer than asked only at end of file or on error.
+ */
+std::size_t readAt(int fd, char* out, std::size_t bytes, std::uint64_t offset) {
+    std::size_t done = 0;
+    while (done < bytes) {
+        ssize_t n = pread(fd, out + done, bytes - done, static_cast<off_t>(offset + done));
+        if (n <= 0) {
+            break;
+        }
+        done += n;
+    }
+    return done;
+}
+
+bool writeAt(int fd, const char* in, std::size_t bytes, std::uint64_t offset) {
+    std::size_t done = 0;
+    while (done < bytes) {
+        ssize_t n = pwrite(fd, in + done, bytes - done, static_cast<off_t>(offset + done));
+        if (n <= 0) {
+            return false;
+        }
+        done += n;
+    }
+    return true;
+}
+
+}
+
+ChunkedMap::~ChunkedMap() {
+    close();
+}
+
+bool ChunkedMap::open(const std::string& fileName, std::uint64_t cacheBytes, Player& player) {
+    close();
+    fd = ::open(fileName.c_str(), O_RDWR);
+    if (fd < 0) {
+        cout << "Error: File unable to open: " << fileName << endl;
+        return false;
+    }
+    ChunkFileHeader header;
+    if (readAt(fd, reinterpret_cast<char*>(&header), sizeof(header), 0) != sizeof(header) ||
+        std::memcmp(header.magic, CHUNK_MAGIC, sizeof(CHUNK_MAGIC)) != 0 ||
+        header.rows <= 0 || header.cols <= 0 || header.rows > INT32_MAX || header.cols > INT32_MAX ||
+        header.playerRow < 0 || header.playerRow >= header.rows || header.playerCol < 0 || header.playerCol >= header.cols) {
+        cout << "Error: Map unable to open." << endl;
+        close();
+        return false;
+    }
+
+    slots = static_cast<int>(std::max<std::uint64_t>(MIN_CACHED_CHUNKS,
+                                                     std::min<std::uint64_t>(cacheBytes / CHUNK_BYTES, INT32_MAX / 2)));
+    std::uint64_t total = 1ULL * slots * (CHUNK_BYTES + sizeof(std::uint64_t) + 2 * sizeof(int) + sizeof(bool));
+    block = mapMemoryFits(total) ? mapAlloc(total) : nullptr;
+    if (block == nullptr) {
+        cout << "Error: Map unable to open." << endl;
+        slots = 0;
+        close();
+        return false;
+    }
+    data = static_cast<char*>(block);
+    ids = reinterpret_cast<std::uint64_t*>(data + 1ULL * slots * CHUNK_BYTES);
+    prev = reinterpret_cast<int*>(ids + slots);
+    next = prev + slots;
+    dirty = reinterpret_cast<bool*>(next + slots);
+    index.reserve(slots);
+
+    maxRow = static_cast<int>(header.rows);
+    maxCol = static_cast<int>(header.cols);
+    chunkCols = (static_cast<std::uint64_t>(maxCol) + CHUNK_SIDE - 1) >> CHUNK_SHIFT;
+    dataOffset = sizeof(header);
+    player.row = static_cast<int>(header.playerRow);
+    player.col = static_cast<int>(header.playerCol);
+    return true;
+}
+
+bool ChunkedMap::flush() {
+    bool ok = true;
+    for (int slot = 0; slot < used; ++slot) {
+        ok = writeBack(slot) && ok;
+    }
+    return ok;
+}
+
+bool ChunkedMap::close() {
+    bool ok = flush() && !lost;
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    mapFree(block);
+    fd = -1;
+    block = nullptr;
+    data = nullptr;
+    ids = nullptr;
+    prev = nullptr;
+    next = nullptr;
+    dirty = nullptr;
+    slots = 0;
+    used = 0;
+    newest = -1;
+    oldest = -1;
+    lastSlot = -1;
+    lost = false;
+    index.clear();
+    maxRow = 0;
+    maxCol = 0;
+    return ok;
+}
+
+void ChunkedMap::touch(int slot) {
+    if (slot == newest) {
+        return;
+    }
+    // unlink, unless the slot is new
+    if (prev[slot] != -1 || next[slot] != -1 || slot == oldest) {
+        if (prev[slot] != -1) {
+            next[prev[slot]] = next[slot];
+        }
+        if (next[slot] != -1) {
+            prev[next[slot]] = prev[slot];
+        }
+        if (slot == oldest) {
+            oldest = prev[slot];
+        }
+    }
+    prev[slot] = -1;
+    next[slot] = newest;
+    if (newest != -1) {
+        prev[newest] = slot;
+    }
+    newest = slot;
+    if (oldest == -1) {
+        oldest = slot;
+    }
+}
+
+bool ChunkedMap::writeBack(int slot) {
+    if (!dirty[slot]) {
+        return true;
+    }
+    cacheStats.writebacks++;
+    if (!writeAt(fd, data + 1ULL * slot * CHUNK_BYTES, CHUNK_BYTES, dataOffset + ids[slot] * CHUNK_BYTES)) {
+        std::cerr << "Error: unable to write back map chunk " << ids[slot] << endl;
+        return false;
+    }
+    dirty[slot] = false;
+    return true;
+}
+
+char* ChunkedMap::pageIn(std::uint64_t id) {
+    auto found = index.find(id);
+    int slot = 0;
+    if (found != index.end()) {
+        cacheStats.hits++;
+        slot = found->second;
+    } else {
+        cacheStats.misses++;
+        if (used < slots) {
+            slot = used++;
+            prev[slot] = -1;
+            next[slot] = -1;
+        } else {
+            // evict the least recently used chunk that is saved, keeping any that could not be
+            slot = oldest;
+            while (slot != -1 && !writeBack(slot)) {
+                slot = prev[slot];
+            }
+            if (slot == -1) {
+                lost = true;
+                return nullptr;
+            }
+            index.erase(ids[slot]);
+        }
+        char* chunk = data + 1ULL * slot * CHUNK_BYTES;
+        std::size_t got = readAt(fd, chunk, CHUNK_BYTES, dataOffset + id * CHUNK_BYTES);
+        std::memset(chunk + got, TILE_OPEN, CHUNK_BYTES - got);
+        ids[slot] = id;
+        dirty[slot] = false;
+        index[id] = slot;
+    }
+    touch(slot);
+    lastSlot = slot;
+    return data + 1ULL * slot * CHUNK_BYTES;
+}
+
+bool createChunkFile(const std::string& levelFile, const std::string& chunkFile) {
+    std::ifstream ifs(levelFile);
+    if (!ifs.is_open()) {
+        cout << "Error: File unable to open: " << levelFile << endl;
+        return false;
+    }
+    ChunkFileHeader header;
+    std::memcpy(header.magic, CHUNK_MAGIC, sizeof(CHUNK_MAGIC));
+    ifs >> header.rows >> header.cols >> header.playerRow >> header.playerCol;
+    if (!ifs || header.rows <= 0 || header.cols <= 0 || header.rows > INT32_MAX || header.cols > INT32_MAX ||
+        header.playerRow < 0 || header.playerRow >= header.rows || header.playerCol < 0 || header.playerCol >= header.cols) {
+        cout << "Error: Map unable to open." << endl;
+        return false;
+    }
+    std::ofstream ofs(chunkFile, std::ios::binary | std::ios::trunc);
+    if (!ofs.is_open()) {
+        cout << "Error: File unable to open: " << chunkFile << endl;
+        return false;
+    }
+    ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    // chunks are numbered row-major, so a strip of CHUNK_SIDE rows is written in order
+    std::uint64_t chunkCols = (static_cast<std::uint64_t>(header.cols) + CHUNK_SIDE - 1) >> CHUNK_SHIFT;
+    std::vector<char> strip(chunkCols * CHUNK_BYTES);
+    for (std::int64_t top = 0; top < header.rows; top += CHUNK_SIDE) {
+        std::fill(strip.begin(), strip.end(), TILE_OPEN);
+        std::int64_t bottom = std::min<std::int64_t>(top + CHUNK_SIDE, header.rows);
+        for (std::int64_t i = top; i < bottom; ++i) {
+            for (std::int64_t j = 0; j < header.cols; ++j) {
+                char tile = TILE_OPEN;
+                ifs >> tile;
+                if (i == header.playerRow && j == header.playerCol) {
+                    tile = TILE_PLAYER;
+                }
+                strip[(j >> CHUNK_SHIFT) * CHUNK_BYTES + ((i - top) << CHUNK_SHIFT) + (j & (CHUNK_SIDE - 1))] = tile;
+            }
+        }
+        // a level that ends early is not padded out; it leaves no chunk file behind
+        if (!ifs) {
+            cout << "Error: Map unable to open." << endl;
+            ofs.close();
+            std::remove(chunkFile.c_str());
+            return false;
+        }
+        ofs.write(strip.data(), strip.size());
+    }
+    return static_cast<bool>(ofs);
+}
+
+void outputChunkedViewport(ChunkedMap& map, int top, int left, int height, int width) {
+    PROFILE_PHASE(PHASE_RENDER);
+    top = std::max(0, std::min(top, map.rows() - 1));
+    left = std::max(0, std::min(left, map.cols() - 1));
+    height = std::max(0, std::min(height, map.rows() - top));
+    width = std::max(0, std::min(width, map.cols() - left));
+    PROFILE_COUNT(COUNTER_BYTES_RENDERED, (height + 2LL) * (width * 1LL * DISPLAY_WIDTH + 3));
+
+    // one output line: the borders, DISPLAY_WIDTH characters per tile and a newline
+    std::vector<char> line(width * DISPLAY_WIDTH + 3, '-');
+    line.front() = '+';
+    line[line.size() - 2] = '+';
+    line.back() = '\n';
+    cout.write(line.data(), line.size());
+
+    std::fill(line.begin() + 1, line.end() - 2, ' ');
+    line.front() = '|';
+    line[line.size() - 2] = '|';
+    for (int i = top; i < top + height; ++i) {
+        for (int j = 0; j < width; ++j) {
+            char tile = map.get(i, left + j);
+            line[1 + j * DISPLAY_WIDTH + 1] = tile == TILE_OPEN ? ' ' : tile;
+        }
+        cout.write(line.data(), line.size());
+    }
+
+    std::fill(line.begin() + 1, line.end() - 2, '-');
+    line.front() = '+';
+    line[line.size() - 2] = '+';
+    cout.write(line.data(), line.size());
+    cout.flush();
+}
@@ -0,0 +1,155 @@
+#ifndef CHUNKEDMAP_H
+#define CHUNKEDMAP_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include "logic.h"
+#include "mapmemory.h"
+
+// Map paged in from disk, for levels larger than memory.
+// The level lives in a chunk file: a header followed by 64x64-tile chunks, each
+// stored as 4 KiB. ChunkedMap keeps a bounded number of chunks in an LRU cache.
+// A miss reads one chunk, and evicting a modified chunk writes it back first; a chunk
+// whose write-back fails stays cached, and the next oldest saved chunk is evicted instead.
+// If every cached chunk is modified and unsaved, get reads TILE_OPEN, set is dropped and
+// close reports the failure.
+// Memory stays bounded by the cache size, whatever the level size. Only the chunks
+// that moves, monster scans and rendering touch are ever read.
+// createChunkFile converts a text level into a chunk file one strip of 64 rows at a time.
+
+// side of a chunk, as a shift and in tiles
+const int CHUNK_SHIFT = 6;
+const int CHUNK_SIDE = 1 << CHUNK_SHIFT;
+const int CHUNK_BYTES = CHUNK_SIDE * CHUNK_SIDE;
+
+// fewest chunks a cache holds: the player's chunk and its neighbours
+const int MIN_CACHED_CHUNKS = 4;
+
+// cache activity since the map was opened
+struct ChunkCacheStats {
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+    std::uint64_t writebacks = 0;
+};
+
+class ChunkedMap {
+public:
+    ChunkedMap() = default;
+    ~ChunkedMap();
+    ChunkedMap(const ChunkedMap&) = delete;
+    ChunkedMap& operator=(const ChunkedMap&) = delete;
+
+    /**
+     * Open a chunk file, writing back and closing the current one.
+     * @param   fileName    Chunk file written by createChunkFile.
+     * @param   cacheBytes  Memory for cached chunks; at least MIN_CACHED_CHUNKS are kept.
+     * @param   player      Player object by reference to set starting position.
+     * @return  true on success, false if the file cannot be opened, is not a chunk file,
+     *          places the player off the map or the cache exceeds the memory budget.
+     * @update  player
+     */
+    bool open(const std::string& fileName, std::uint64_t cacheBytes, Player& player);
+
+    /**
+     * Write back every modified chunk and close the file.
+     * @return  true if every write succeeded and every chunk could be paged in since open.
+     */
+    bool close();
+
+    /**
+     * Write back every modified chunk, keeping them cached.
+     * @return  true if every write succeeded.
+     */
+    bool flush();
+
+    int rows() const { return maxRow; }
+    int cols() const { return maxCol; }
+
+    char get(int row, int col) {
+        char* chunk = chunkFor(row, col);
+        return chunk == nullptr ? TILE_OPEN : chunk[tileIndex(row, col)];
+    }
+
+    void set(int row, int col, char tile) {
+        char* chunk = chunkFor(row, col);
+        if (chunk == nullptr) {
+            return;
+        }
+        dirty[lastSlot] = true;
+        chunk[tileIndex(row, col)] = tile;
+    }
+
+    const ChunkCacheStats& stats() const { return cacheStats; }
+
+    // bytes of map memory held by the cache
+    std::uint64_t bytes() const { return 1ULL * slots * (CHUNK_BYTES + 2 * sizeof(int) + sizeof(std::uint64_t) + 1); }
+
+private:
+    static int tileIndex(int row, int col) {
+        return ((row & (CHUNK_SIDE - 1)) << CHUNK_SHIFT) | (col & (CHUNK_SIDE - 1));
+    }
+
+    // cached data of the chunk holding (row, col), paging it in on a miss; nullptr if no
+    // cached chunk can be evicted without losing changes
+    char* chunkFor(int row, int col) {
+        std::uint64_t id = 1ULL * (row >> CHUNK_SHIFT) * chunkCols + (col >> CHUNK_SHIFT);
+        if (lastSlot >= 0 && ids[lastSlot] == id) {
+            cacheStats.hits++;
+            return data + 1ULL * lastSlot * CHUNK_BYTES;
+        }
+        return pageIn(id);
+    }
+
+    char* pageIn(std::uint64_t id);
+    void touch(int slot);
+    bool writeBack(int slot);
+
+    using SlotIndex = std::unordered_map<std::uint64_t, int, std::hash<std::uint64_t>, std::equal_to<std::uint64_t>,
+                                         MapAllocator<std::pair<const std::uint64_t, int>>>;
+
+    int fd = -1;
+    int maxRow = 0;
+    int maxCol = 0;
+    std::uint64_t chunkCols = 0;
+    std::uint64_t dataOffset = 0;
+
+    void* block = nullptr;
+    char* data = nullptr;
+    std::uint64_t* ids = nullptr;
+    int* prev = nullptr;
+    int* next = nullptr;
+    bool* dirty = nullptr;
+    int slots = 0;
+    int used = 0;
+    int newest = -1;
+    int oldest = -1;
+    int lastSlot = -1;
+    bool lost = false;                  // a chunk could not be paged in since open
+    SlotIndex index;
+    ChunkCacheStats cacheStats;
+};
+
+/**
+ * Convert a text level into a chunk file, marking the player's tile.
+ * Holds one strip of CHUNK_SIDE rows in memory at a time.
+ * @param   levelFile   Text level in the loadLevel format.
+ * @param   chunkFile   Destination chunk file.
+ * @return  true on success, false if either file cannot be used, the player is off the
+ *          map or the level ends before its last tile.
+ */
+bool createChunkFile(const std::string& levelFile, const std::string& chunkFile);
+
+/**
+ * Print a window of the map in outputMap's format, paging in only its chunks.
+ * The window is clamped to the map.
+ * @param   map         Chunked map.
+ * @param   top         First row of the window.
+ * @param   left        First column of the window.
+ * @param   height      Rows in the window.
+ * @param   width       Columns in the window.
+ * @return None
+ */
+void outputChunkedViewport(ChunkedMap& map, int top, int left, int height, int width);
+
+#endif
@@ -1,8 +1,16 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <cstdlib>
+#include <cstring>
 #include "helper.h"
 #include "logic.h"
+#include "profile.h"
+#include "mapmemory.h"
+#include "roomarena.h"
+#include "entities.h"
+#include "pillarindex.h"
+#include "flowfield.h"
 using std::cin, std::cout, std::endl, std::string, std::ifstream;
 
 
@@ -18,10 +26,37 @@ int main() {
     cout << "Please enter the dungeon name and number of levels: ";
     cin >> dungeon >> total_rooms;
 
+    // reuse one buffer for the level file names so room transitions do not allocate
+    string fileName;
+    fileName.reserve(dungeon.size() + 16);
+
+    // map storage lives in an arena that is emptied whenever the player leaves a room;
+    // small rooms fit in its inline storage and never touch the heap
+    SmallRoomArena roomArena;
+    setMapArena(&roomArena);
+
+    // pillar segments of the current map; monsters fall back to scanning without it
+    PillarIndex pillars;
+
+    // monsters, treasures and amulets of the current map, when monsters charge in line
+    // of sight
+    EntityStore entities;
+
+    // with DUNGEON_MONSTERS=chase monsters follow a flow field to the player instead
+    // of charging in line of sight; with swarm they all step at once along it
+    const char* monsterMode = std::getenv("DUNGEON_MONSTERS");
+    bool swarm = monsterMode != nullptr && std::strcmp(monsterMode, "swarm") == 0;
+    bool chase = swarm || (monsterMode != nullptr && std::strcmp(monsterMode, "chase") == 0);
+    FlowField flow;
+
     int total_moves = 0;
     for(int current_room = 1; current_room <= total_rooms; current_room++) {
         cout << "Level " << current_room << endl;
-        string fileName = dungeon + std::to_string(current_room) + ".txt";
+        PROFILE_ROOM(current_room);
+        mapMemoryBeginRoom(current_room);
+        fileName = dungeon;
+        fileName += std::to_string(current_room);
+        fileName += ".txt";
 
         // declare variables
         int maxRow  = 0;
@@ -30,11 +65,15 @@ int main() {
         int nextCol = 0;
 
         // create map, or quit if map load error
-        char** map = loadLevel(fileName, maxRow, maxCol, player);
+        char** map = chase ? loadLevel(fileName, maxRow, maxCol, player)
+                           : loadLevel(fileName, maxRow, maxCol, player, entities);
         if (map == nullptr) {
             cout << "Returning you back to the real word, adventurer!" << endl;
             return 1;
         }
+        if (!chase || !flow.build(map, maxRow, maxCol)) {
+            pillars.build(map, maxRow, maxCol);
+        }
         
         // display map
         outputMap(map, maxRow, maxCol);
@@ -45,7 +84,10 @@ int main() {
         while (true) {
             // get user input
             cout << "Enter command (w,a,s,d: move, e: stay still, q: quit): ";
-            cin >> input;
+            {
+                PROFILE_PHASE(PHASE_INPUT);
+                cin >> input;
+            }
 
             // quit game if user inputs quit
             if (input == INPUT_QUIT) {
@@ -60,6 +102,8 @@ int main() {
                 continue;
             }
 
+            PROFILE_PHASE(PHASE_TURN);
+
             // increment dungeon movement counter
             total_moves++;
             if (input == INPUT_STAY) {
@@ -72,7 +116,11 @@ int main() {
                 getDirection(input, nextRow, nextCol);
 
                 // move player to new location index, if possible, and get player status
-                status = doPlayerMove(map, maxRow, maxCol, player, nextRow, nextCol);
+                if (entities.built()) {
+                    status = doPlayerMove(map, maxRow, maxCol, player, nextRow, nextCol, entities);
+                } else {
+                    status = doPlayerMove(map, maxRow, maxCol, player, nextRow, nextCol);
+                }
             }
 
             // quit game if user escapes
@@ -91,7 +139,21 @@ int main() {
             }
 
             // move monsters, end if player is caught
-            if (doMonsterAttack(map, maxRow, maxCol, player)) {
+            bool caught = false;
+            if (flow.built() && swarm) {
+                caught = doMonsterSwarm(map, maxRow, maxCol, player, flow);
+            } else if (flow.built()) {
+                caught = doMonsterChase(map, maxRow, maxCol, player, flow);
+            } else if (pillars.built() && entities.built()) {
+                caught = doMonsterAttack(map, maxRow, maxCol, player, pillars, entities);
+            } else if (pillars.built()) {
+                caught = doMonsterAttack(map, maxRow, maxCol, player, pillars);
+            } else if (entities.built()) {
+                caught = doMonsterAttack(map, maxRow, maxCol, player, entities);
+            } else {
+                caught = doMonsterAttack(map, maxRow, maxCol, player);
+            }
+            if (caught) {
                 outputMap(map, maxRow, maxCol);
                 cout << "You died, adventurer! Better luck next time!" << endl;
                 deleteMap(map, maxRow);
@@ -100,7 +162,16 @@ int main() {
 
             // use amulet
             if (status == STATUS_AMULET) {
-                map = resizeMap(map, maxRow, maxCol);
+                int oldRow = maxRow;
+                map = resizeMap(map, maxRow, maxCol, player);
+                if (maxRow == oldRow) {
+                    cout << "The amulet flickers, but the dungeon cannot grow any larger." << endl;
+                } else if (!chase || !flow.build(map, maxRow, maxCol)) {
+                    pillars.build(map, maxRow, maxCol);
+                    if (!chase) {
+                        entities.build(map, maxRow, maxCol);
+                    }
+                }
             }
             
             // display map and status
@@ -110,7 +181,12 @@ int main() {
         }
 
         // delete map
+        flow.release();
+        entities.release();
+        pillars.release();
         deleteMap(map, maxRow);
+        mapMemoryEndRoom();
+        roomArena.reset();
     }
     return 0;
 }
@@ -0,0 +1,198 @@
+#include <cstdint>
+#include "entities.h"
+#include "mapops.h"
+#include "profile.h"
+
+namespace {
+
+// whether a tile holds an entity the store lists
+bool isEntity(char tile) {
+    return tile == TILE_MONSTER || tile == TILE_TREASURE || tile == TILE_AMULET;
+}
+
+// char** map whose monster steps are followed in its store
+struct StoreMap : CharMap {
+    EntityStore& entities;
+    bool moved;                         // a monster stepped onto a tile without one
+};
+
+// found by the mapops.h scans in place of the plain stepMonster
+void stepMonster(StoreMap& map, int row, int col, int toRow, int toCol) {
+    map.moved = map.moved || map.get(toRow, toCol) != TILE_MONSTER;
+    ::stepMonster<CharMap>(map, row, col, toRow, toCol);
+    map.entities.step(row, col, toRow, toCol);
+}
+
+}
+
+EntityStore::~EntityStore() {
+    release();
+}
+
+bool EntityStore::build(char** map, int rows, int cols) {
+    PROFILE_PHASE(PHASE_INDEX);
+    release();
+    if (rows <= 0 || cols <= 0) {
+        return false;
+    }
+    std::size_t tiles = static_cast<std::size_t>(rows) * cols;
+    std::size_t found = 0;
+    for (int i = 0; i < rows; ++i) {
+        for (int j = 0; j < cols; ++j) {
+            found += isEntity(map[i][j]);
+        }
+    }
+    const std::size_t entityBytes = sizeof(int) + sizeof(int) + sizeof(std::uint32_t) + sizeof(char);
+    if (found >= NO_ENTITY || tiles > (SIZE_MAX - entityBytes * found) / sizeof(std::uint32_t)) {
+        return false;
+    }
+    slots = static_cast<std::uint32_t*>(mapAlloc(sizeof(std::uint32_t) * tiles + entityBytes * found));
+    if (slots == nullptr) {
+        return false;
+    }
+    entityRows = reinterpret_cast<int*>(slots + tiles);
+    entityCols = entityRows + found;
+    moved = reinterpret_cast<std::uint32_t*>(entityCols + found);
+    kinds = reinterpret_cast<char*>(moved + found);
+    capacity = found;
+    maxRow = rows;
+    maxCol = cols;
+
+    // list the entities in map order
+    for (int i = 0; i < rows; ++i) {
+        std::uint32_t* line = slots + static_cast<std::size_t>(i) * cols;
+        for (int j = 0; j < cols; ++j) {
+            char tile = map[i][j];
+            if (!isEntity(tile)) {
+                line[j] = NO_ENTITY;
+                continue;
+            }
+            line[j] = static_cast<std::uint32_t>(listed);
+            entityRows[listed] = i;
+            entityCols[listed] = j;
+            moved[listed] = 0;
+            kinds[listed] = tile;
+            listed++;
+            monsters += tile == TILE_MONSTER;
+            treasures += tile == TILE_TREASURE;
+            amulets += tile == TILE_AMULET;
+        }
+    }
+    return true;
+}
+
+void EntityStore::step(int row, int col, int toRow, int toCol) {
+    if (row == quietRow || col == quietCol || toRow == quietRow || toCol == quietCol) {
+        quietRow = -1;
+        quietCol = -1;
+    }
+    std::uint32_t& from = slots[static_cast<std::size_t>(row) * maxCol + col];
+    std::uint32_t& to = slots[static_cast<std::size_t>(toRow) * maxCol + toCol];
+    std::uint32_t leaving = from;
+    std::uint32_t displaced = to;
+    from = displaced;
+    to = leaving;
+    if (leaving != NO_ENTITY) {
+        entityRows[leaving] = toRow;
+        entityCols[leaving] = toCol;
+        moved[leaving] = turn;
+    }
+    if (displaced != NO_ENTITY) {
+        entityRows[displaced] = row;
+        entityCols[displaced] = col;
+    }
+}
+
+void EntityStore::take(int row, int col) {
+    std::uint32_t& slot = slots[static_cast<std::size_t>(row) * maxCol + col];
+    std::uint32_t gone = slot;
+    if (gone == NO_ENTITY) {
+        return;
+    }
+    if (row == quietRow || col == quietCol) {
+        quietRow = -1;
+        quietCol = -1;
+    }
+    slot = NO_ENTITY;
+    monsters -= kinds[gone] == TILE_MONSTER;
+    treasures -= kinds[gone] == TILE_TREASURE;
+    amulets -= kinds[gone] == TILE_AMULET;
+
+    // the last entity fills the gap
+    std::uint32_t last = static_cast<std::uint32_t>(--listed);
+    if (gone != last) {
+        entityRows[gone] = entityRows[last];
+        entityCols[gone] = entityCols[last];
+        moved[gone] = moved[last];
+        kinds[gone] = kinds[last];
+        slots[static_cast<std::size_t>(entityRows[gone]) * maxCol + entityCols[gone]] = gone;
+    }
+}
+
+void EntityStore::release() {
+    // the entity arrays share the slots' block
+    mapFree(slots);
+    slots = nullptr;
+    entityRows = nullptr;
+    entityCols = nullptr;
+    moved = nullptr;
+    kinds = nullptr;
+    listed = 0;
+    capacity = 0;
+    monsters = 0;
+    treasures = 0;
+    amulets = 0;
+    turn = 0;
+    maxRow = 0;
+    maxCol = 0;
+    quietRow = -1;
+    quietCol = -1;
+}
+
+std::uint64_t EntityStore::bytes() const {
+    if (!built()) {
+        return 0;
+    }
+    return sizeof(std::uint32_t) * (1ULL * maxRow * maxCol)
+         + (sizeof(int) + sizeof(int) + sizeof(std::uint32_t) + sizeof(char)) * capacity;
+}
+
+char** loadLevel(const std::string& fileName, int& maxRow, int& maxCol, Player& player, EntityStore& entities) {
+    entities.release();
+    char** map = loadLevel(fileName, maxRow, maxCol, player);
+    if (map != nullptr) {
+        entities.build(map, maxRow, maxCol);
+    }
+    return map;
+}
+
+int doPlayerMove(char** map, int maxRow, int maxCol, Player& player, int nextRow, int nextCol,
+                 EntityStore& entities) {
+    int status = doPlayerMove(map, maxRow, maxCol, player, nextRow, nextCol);
+    if (status == STATUS_TREASURE || status == STATUS_AMULET) {
+        entities.take(player.row, player.col);
+    }
+    return status;
+}
+
+bool doMonsterAttack(char** map, int maxRow, int maxCol, const Player& player, EntityStore& entities) {
+    PROFILE_PHASE(PHASE_MONSTER);
+    entities.beginTurn();
+    if (entities.count(TILE_MONSTER) == 0) {
+        return map[player.row][player.col] == TILE_MONSTER;
+    }
+    if (entities.quiet(player)) {
+        return false;
+    }
+
+    StoreMap tiles{{map, maxRow, maxCol}, entities, false};
+    monsterScanRow(tiles, player);
+    monsterScanColumn(tiles, player);
+
+    // the same lines would give the same scans next turn
+    bool caught = map[player.row][player.col] == TILE_MONSTER;
+    if (!tiles.moved && !caught) {
+        entities.markQuiet(player);
+    }
+    return caught;
+}
@@ -0,0 +1,176 @@
+#ifndef ENTITIES_H
+#define ENTITIES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "logic.h"
+#include "mapmemory.h"
+
+// Monsters, treasures and amulets of a char** map, kept apart from its tiles.
+// Entities are packed into parallel arrays of rows, columns, kinds and states, so
+// walking them never touches the map, and every tile holds the slot of the entity on
+// it, so the entity on a tile is one lookup away. The map stays the grid everything is
+// drawn from; the overloads below change both together. Collected entities are
+// replaced by the last one, which keeps the arrays packed. The store also remembers
+// the last tile from which a monster turn moved nothing; until the player leaves it or
+// a tile in its row or column changes, the next turn would move nothing too and is
+// skipped. Build the store after loadLevel and again after every resizeMap, or after
+// changing tiles any other way. Storage comes from tracked map memory, in one block.
+
+// slot of tiles without an entity
+const std::uint32_t NO_ENTITY = ~std::uint32_t(0);
+
+/**
+ * Map memory a store of a map with up to the given number of tiles can take, counting
+ * the block header and arena alignment. A map of nothing but entities is the worst case.
+ * @param   tiles       Number of tiles.
+ * @return  bytes of the block.
+ */
+constexpr std::size_t entityStoreBytes(std::size_t tiles) {
+    return (MAP_HEADER_BYTES + (4 + 4 + 4 + 4 + 1) * tiles + 15) / 16 * 16;
+}
+
+class EntityStore {
+public:
+    EntityStore() = default;
+    ~EntityStore();
+    EntityStore(const EntityStore&) = delete;
+    EntityStore& operator=(const EntityStore&) = delete;
+
+    /**
+     * List the monsters, treasures and amulets of a map, releasing the current store.
+     * @param   map         Dungeon map.
+     * @param   maxRow      Number of rows.
+     * @param   maxCol      Number of columns.
+     * @return  true on success, false if the size is invalid or exceeds the memory budget.
+     */
+    bool build(char** map, int maxRow, int maxCol);
+
+    /**
+     * Swap the entity on a tile, if any, with whatever is on a neighbouring tile,
+     * following a move made on the map. A monster that moves is stamped with the turn.
+     * @param   row         Row of the tile left.
+     * @param   col         Column of the tile left.
+     * @param   toRow       Row of the tile entered.
+     * @param   toCol       Column of the tile entered.
+     * @return None
+     */
+    void step(int row, int col, int toRow, int toCol);
+
+    /**
+     * Remove the entity on a tile, if any, as when the player collects it.
+     * @param   row         Row of the tile.
+     * @param   col         Column of the tile.
+     * @return None
+     */
+    void take(int row, int col);
+
+    // start a new monster turn for the stamps step leaves
+    void beginTurn() { turn++; }
+
+    // whether a monster turn with the player here is known to move nothing
+    bool quiet(const Player& player) const { return player.row == quietRow && player.col == quietCol; }
+
+    // remember that a monster turn with the player here moved nothing
+    void markQuiet(const Player& player) {
+        quietRow = player.row;
+        quietCol = player.col;
+    }
+
+    /**
+     * Free the store. Call it before the room arena the store came from is reset.
+     * @return None
+     */
+    void release();
+
+    // whether build succeeded and the store has not been released since
+    bool built() const { return slots != nullptr; }
+
+    // slot of the entity on a tile, NO_ENTITY if there is none
+    std::uint32_t at(int row, int col) const {
+        return slots[static_cast<std::size_t>(row) * maxCol + col];
+    }
+
+    // number of entities, in slots [0, size())
+    std::size_t size() const { return listed; }
+
+    // number of entities of a kind: TILE_MONSTER, TILE_TREASURE or TILE_AMULET
+    std::size_t count(char kind) const {
+        return kind == TILE_MONSTER ? monsters : kind == TILE_TREASURE ? treasures : kind == TILE_AMULET ? amulets : 0;
+    }
+
+    // position of an entity
+    int row(std::uint32_t slot) const { return entityRows[slot]; }
+    int col(std::uint32_t slot) const { return entityCols[slot]; }
+
+    // tile the entity is drawn as
+    char kind(std::uint32_t slot) const { return kinds[slot]; }
+
+    // turn the entity last moved on, 0 if it never has
+    std::uint32_t movedOn(std::uint32_t slot) const { return moved[slot]; }
+
+    // bytes held by the store
+    std::uint64_t bytes() const;
+
+private:
+    std::uint32_t* slots = nullptr;     // maxRow x maxCol, row-major
+    int* entityRows = nullptr;          // the entity arrays, indexed by slot
+    int* entityCols = nullptr;
+    std::uint32_t* moved = nullptr;
+    char* kinds = nullptr;
+    std::size_t listed = 0;
+    std::size_t capacity = 0;           // entities at build
+    std::size_t monsters = 0;
+    std::size_t treasures = 0;
+    std::size_t amulets = 0;
+    std::uint32_t turn = 0;
+    int maxRow = 0;
+    int maxCol = 0;
+    int quietRow = -1;                  // player's tile of the last turn that moved nothing
+    int quietCol = -1;
+};
+
+/**
+ * Load a dungeon level as loadLevel in logic.h does and list its entities.
+ * @param   fileName    File name of dungeon level.
+ * @param   maxRow      Number of rows in the dungeon table (aka height).
+ * @param   maxCol      Number of columns in the dungeon table (aka width).
+ * @param   player      Player object by reference to set starting position.
+ * @param   entities    Store rebuilt for the map; left released if it does not fit.
+ * @return  the map, or nullptr if loading fails for any reason.
+ * @update  maxRow, maxCol, player, entities
+ */
+char** loadLevel(const std::string& fileName, int& maxRow, int& maxCol, Player& player, EntityStore& entities);
+
+/**
+ * Move the player exactly as doPlayerMove in logic.h does, removing a treasure or
+ * amulet the player steps onto from the store.
+ * @param   map         Dungeon map the store was built for.
+ * @param   maxRow      Number of rows in the dungeon table (aka height).
+ * @param   maxCol      Number of columns in the dungeon table (aka width).
+ * @param   player      Player object to by reference to see current location.
+ * @param   nextRow     Player's next row on the dungeon map (up/down).
+ * @param   nextCol     Player's next column on dungeon map (left/right).
+ * @param   entities    Store of the map.
+ * @return  Player's movement status after updating player's position.
+ * @update map contents, player, entities
+ */
+int doPlayerMove(char** map, int maxRow, int maxCol, Player& player, int nextRow, int nextCol,
+                 EntityStore& entities);
+
+/**
+ * Update monster locations exactly as doMonsterAttack in logic.h does, following every
+ * move in the store. A room without monsters costs nothing, and neither does a turn
+ * the store knows to be quiet.
+ * @param   map         Dungeon map the store was built for.
+ * @param   maxRow      Number of rows in the dungeon table (aka height).
+ * @param   maxCol      Number of columns in the dungeon table (aka width).
+ * @param   player      Player object by reference for current location.
+ * @param   entities    Store of the map.
+ * @return  true if a monster reaches the player, false if not.
+ * @update map contents, entities
+ */
+bool doMonsterAttack(char** map, int maxRow, int maxCol, const Player& player, EntityStore& entities);
+
+#endif
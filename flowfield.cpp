@@ -0,0 +1,424 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include "flowfield.h"
+#include "parallel.h"
+#include "profile.h"
+
+namespace {
+
+// component of open tiles not labelled yet
+const std::uint32_t UNLABELLED = ~std::uint32_t(0);
+
+// bits of the distance ordered per pass of the monster sort
+const int SORT_BITS = 11;
+
+// bytes one monster's step touches: its spot, the field around it and its map tiles
+const std::size_t MONSTER_STEP_BYTES = 8 * 64;
+
+// steps to the up, left, right and down neighbours; a step and its opposite add up to 3
+const int ROW_STEP[4] = {-1, 0, 0, 1};
+const int COL_STEP[4] = {0, -1, 1, 0};
+
+}
+
+FlowField::~FlowField() {
+    release();
+}
+
+bool FlowField::build(char** map, int rows, int cols) {
+    PROFILE_PHASE(PHASE_FLOW);
+    release();
+    if (rows <= 0 || cols <= 0) {
+        return false;
+    }
+    // tile indices, labels and distances are 32-bit, with room for the sentinels
+    std::uint64_t padded = (rows + 2ULL) * (cols + 2ULL);
+    std::uint64_t tiles = 1ULL * rows * cols;
+    if (padded >= FLOW_UNREACHED) {
+        return false;
+    }
+    distances = static_cast<std::uint32_t*>(mapAlloc(sizeof(std::uint32_t) * (2 * padded + tiles + 1) + padded));
+    if (distances == nullptr) {
+        return false;
+    }
+    components = distances + padded;
+    queue = components + padded;
+    proposals = reinterpret_cast<std::uint8_t*>(queue + tiles + 1);
+    std::memset(proposals, 0, padded);
+    width = static_cast<std::uint32_t>(cols) + 2;
+    maxRow = rows;
+    maxCol = cols;
+
+    // copy the pillars inside a blocked border and count the monsters
+    std::fill(distances, distances + width, FLOW_BLOCKED);
+    std::fill(distances + padded - width, distances + padded, FLOW_BLOCKED);
+    std::fill(components, components + width, 0);
+    std::fill(components + padded - width, components + padded, 0);
+    for (int i = 0; i < rows; ++i) {
+        std::uint32_t* line = distances + tile(i, 0);
+        std::uint32_t* area = components + tile(i, 0);
+        line[-1] = FLOW_BLOCKED;
+        line[cols] = FLOW_BLOCKED;
+        area[-1] = 0;
+        area[cols] = 0;
+        for (int j = 0; j < cols; ++j) {
+            bool pillar = map[i][j] == TILE_PILLAR;
+            line[j] = pillar ? FLOW_BLOCKED : FLOW_UNREACHED;
+            area[j] = pillar ? 0 : UNLABELLED;
+            monsters += map[i][j] == TILE_MONSTER;
+        }
+    }
+    labelComponents();
+
+    std::size_t room = std::max<std::size_t>(monsters, 1);
+    spots = static_cast<MonsterSpot*>(mapAlloc((2 * sizeof(MonsterSpot) + 1) * room));
+    if (spots == nullptr) {
+        release();
+        return false;
+    }
+    sorted = spots + room;
+    winners = reinterpret_cast<std::uint8_t*>(sorted + room);
+    std::size_t next = 0;
+    for (int i = 0; i < rows && next < monsters; ++i) {
+        for (int j = 0; j < cols; ++j) {
+            if (map[i][j] == TILE_MONSTER) {
+                spots[next++] = MonsterSpot{i, j, FLOW_UNREACHED};
+            }
+        }
+    }
+    return true;
+}
+
+void FlowField::labelComponents() {
+    std::uint32_t label = 0;
+    for (int i = 0; i < maxRow; ++i) {
+        for (std::uint32_t start = tile(i, 0), end = start + maxCol; start < end; ++start) {
+            if (components[start] != UNLABELLED) {
+                continue;
+            }
+            // flood the area from its first tile; the queue is free between searches
+            components[start] = ++label;
+            std::uint32_t first = 0;
+            std::uint32_t last = 0;
+            queue[last++] = start;
+            while (first < last) {
+                std::uint32_t t = queue[first++];
+                for (std::uint32_t n : {t - width, t - 1, t + 1, t + width}) {
+                    if (components[n] == UNLABELLED) {
+                        components[n] = label;
+                        queue[last++] = n;
+                    }
+                }
+            }
+        }
+    }
+}
+
+void FlowField::forget() {
+    // a search that covered much of the map is cheaper to clear in one sweep
+    std::size_t padded = static_cast<std::size_t>(width) * (maxRow + 2);
+    if (tail < padded / 8) {
+        for (std::uint32_t i = 0; i < tail; ++i) {
+            distances[queue[i]] = FLOW_UNREACHED;
+        }
+    } else {
+        for (std::size_t i = 0; i < padded; ++i) {
+            distances[i] = distances[i] == FLOW_BLOCKED ? FLOW_BLOCKED : FLOW_UNREACHED;
+        }
+    }
+    head = 0;
+    tail = 0;
+    ordered = false;
+}
+
+void FlowField::restart() {
+    forget();
+    if (sourceRow < 0) {
+        return;
+    }
+    // a pillar placed where the player stood leaves nothing to search from
+    source = tile(sourceRow, sourceCol);
+    if (components[source] == 0) {
+        return;
+    }
+    distances[source] = 0;
+    queue[tail++] = source;
+}
+
+void FlowField::searchTo(std::uint32_t target) {
+    std::uint32_t before = tail;
+    while (distances[target] == FLOW_UNREACHED && head < tail) {
+        std::uint32_t t = queue[head++];
+        std::uint32_t step = distances[t] + 1;
+        for (std::uint32_t n : {t - width, t - 1, t + 1, t + width}) {
+            if (distances[n] == FLOW_UNREACHED) {
+                distances[n] = step;
+                queue[tail++] = n;
+            }
+        }
+    }
+    PROFILE_COUNT(COUNTER_TILES_SCANNED, tail - before);
+    (void)before;
+}
+
+std::uint32_t FlowField::distance(int row, int col) {
+    std::uint32_t t = tile(row, col);
+    if (components[t] == 0) {
+        return FLOW_BLOCKED;
+    }
+    if (sourceRow < 0 || components[t] != components[source]) {
+        return FLOW_UNREACHED;
+    }
+    if (distances[t] == FLOW_UNREACHED) {
+        searchTo(t);
+    }
+    return distances[t];
+}
+
+void FlowField::follow(const Player& player) {
+    if (player.row != sourceRow || player.col != sourceCol) {
+        sourceRow = player.row;
+        sourceCol = player.col;
+        restart();
+    }
+}
+
+void FlowField::update(const Player& player) {
+    follow(player);
+    if (ordered) {
+        return;
+    }
+    PROFILE_PHASE(PHASE_FLOW);
+    ordered = true;
+
+    // radix sort of the monsters by distance, walled-off ones last, which settles the
+    // field out to the farthest one. A turn in which every monster steps, or every
+    // monster at a distance waits, keeps the order; checkOrder catches the others.
+    std::uint32_t farthest = 0;
+    for (std::size_t k = 0; k < monsters; ++k) {
+        std::uint32_t d = distance(spots[k].row, spots[k].col);
+        spots[k].distance = d;
+        if (d < FLOW_UNREACHED) {
+            farthest = std::max(farthest, d);
+        }
+    }
+    std::uint32_t walledOff = farthest + 1;
+    auto key = [walledOff](const MonsterSpot& spot) {
+        return spot.distance < FLOW_UNREACHED ? spot.distance : walledOff;
+    };
+    for (int shift = 0; shift < 32 && (shift == 0 || (walledOff >> shift) != 0); shift += SORT_BITS) {
+        std::uint32_t start[1 << SORT_BITS] = {};
+        const std::uint32_t mask = (1 << SORT_BITS) - 1;
+        for (std::size_t k = 0; k < monsters; ++k) {
+            start[(key(spots[k]) >> shift) & mask]++;
+        }
+        std::uint32_t sum = 0;
+        for (std::uint32_t& count : start) {
+            std::uint32_t here = count;
+            count = sum;
+            sum += here;
+        }
+        for (std::size_t k = 0; k < monsters; ++k) {
+            sorted[start[(key(spots[k]) >> shift) & mask]++] = spots[k];
+        }
+        std::swap(spots, sorted);
+    }
+}
+
+bool FlowField::moveMonsters(char** map) {
+    bool caught = false;
+    for (std::size_t k = 0; k < monsters; ++k) {
+        MonsterSpot& spot = spots[k];
+        std::uint32_t d = spot.distance;
+        if (d == 0 || d >= FLOW_UNREACHED) {
+            continue;
+        }
+        // every tile one step closer was settled before this one
+        std::uint32_t t = tile(spot.row, spot.col);
+        const std::uint32_t neighbours[4] = {t - width, t - 1, t + 1, t + width};
+        for (int n = 0; n < 4; ++n) {
+            if (distances[neighbours[n]] != d - 1) {
+                continue;
+            }
+            char& next = map[spot.row + ROW_STEP[n]][spot.col + COL_STEP[n]];
+            if (next == TILE_MONSTER) {
+                continue;
+            }
+            char stay = next;
+            if (stay == TILE_PLAYER) {
+                stay = TILE_OPEN;
+                caught = true;
+            }
+            PROFILE_COUNT(COUNTER_MONSTERS_MOVED, 1);
+            next = TILE_MONSTER;
+            map[spot.row][spot.col] = stay;
+            spot.row += ROW_STEP[n];
+            spot.col += COL_STEP[n];
+            spot.distance = d - 1;
+            break;
+        }
+    }
+    checkOrder();
+    return caught;
+}
+
+bool FlowField::moveMonstersTogether(char** map) {
+    // unsigned offsets of the neighbours; the border keeps every sum inside the grid
+    const std::uint32_t offset[4] = {0 - width, 0 - 1u, 1u, width};
+
+    // each monster picks a free tile one step closer, reading the map as it was
+    parallelFor(monsters, MONSTER_STEP_BYTES, [&](std::size_t first, std::size_t last) {
+        for (std::size_t k = first; k < last; ++k) {
+            const MonsterSpot& spot = spots[k];
+            std::uint32_t d = spot.distance;
+            if (d == 0 || d >= FLOW_UNREACHED) {
+                continue;
+            }
+            std::uint32_t t = tile(spot.row, spot.col);
+            for (int n = 0; n < 4; ++n) {
+                if (distances[t + offset[n]] == d - 1
+                    && map[spot.row + ROW_STEP[n]][spot.col + COL_STEP[n]] != TILE_MONSTER) {
+                    proposals[t] = static_cast<std::uint8_t>(n + 1);
+                    break;
+                }
+            }
+        }
+    });
+
+    // the first monster around a tile, in up, left, right, down order, takes it
+    parallelFor(monsters, MONSTER_STEP_BYTES, [&](std::size_t first, std::size_t last) {
+        for (std::size_t k = first; k < last; ++k) {
+            std::uint32_t t = tile(spots[k].row, spots[k].col);
+            winners[k] = 0;
+            if (proposals[t] == 0) {
+                continue;
+            }
+            std::uint32_t target = t + offset[proposals[t] - 1];
+            for (int n = 0; n < 4; ++n) {
+                std::uint32_t rival = target + offset[n];
+                if (proposals[rival] == 3 - n + 1) {
+                    winners[k] = rival == t;
+                    break;
+                }
+            }
+        }
+    });
+
+    // winners move; their targets are distinct tiles without monsters, so no two moves
+    // touch the same tile
+    std::atomic<bool> caught{false};
+    std::atomic<std::size_t> moved{0};
+    parallelFor(monsters, MONSTER_STEP_BYTES, [&](std::size_t first, std::size_t last) {
+        bool reached = false;
+        std::size_t steps = 0;
+        for (std::size_t k = first; k < last; ++k) {
+            MonsterSpot& spot = spots[k];
+            std::uint32_t t = tile(spot.row, spot.col);
+            int n = proposals[t] - 1;
+            proposals[t] = 0;
+            if (!winners[k]) {
+                continue;
+            }
+            char& next = map[spot.row + ROW_STEP[n]][spot.col + COL_STEP[n]];
+            char stay = next;
+            if (stay == TILE_PLAYER) {
+                stay = TILE_OPEN;
+                reached = true;
+            }
+            next = TILE_MONSTER;
+            map[spot.row][spot.col] = stay;
+            spot.row += ROW_STEP[n];
+            spot.col += COL_STEP[n];
+            spot.distance--;
+            steps++;
+        }
+        if (reached) {
+            caught = true;
+        }
+        moved += steps;
+    });
+    PROFILE_COUNT(COUNTER_MONSTERS_MOVED, moved.load());
+    checkOrder();
+    return caught;
+}
+
+void FlowField::checkOrder() {
+    for (std::size_t k = 1; k < monsters; ++k) {
+        if (spots[k].distance < spots[k - 1].distance) {
+            ordered = false;
+            return;
+        }
+    }
+}
+
+void FlowField::retile(int row, int col, char before, char after) {
+    if ((before == TILE_PILLAR) == (after == TILE_PILLAR)) {
+        return;
+    }
+    // a pillar can join or split open areas anywhere, so label them all again
+    PROFILE_PHASE(PHASE_FLOW);
+    forget();
+    std::uint32_t t = tile(row, col);
+    distances[t] = after == TILE_PILLAR ? FLOW_BLOCKED : FLOW_UNREACHED;
+    components[t] = after == TILE_PILLAR ? 0 : UNLABELLED;
+    std::size_t padded = static_cast<std::size_t>(width) * (maxRow + 2);
+    for (std::size_t i = 0; i < padded; ++i) {
+        if (components[i] != 0) {
+            components[i] = UNLABELLED;
+        }
+    }
+    labelComponents();
+    restart();
+}
+
+void FlowField::release() {
+    // the components, the queue and the proposals share the distances' block, and both
+    // monster lists and the winners share one block
+    mapFree(distances);
+    mapFree(std::min(spots, sorted));
+    distances = nullptr;
+    components = nullptr;
+    queue = nullptr;
+    proposals = nullptr;
+    spots = nullptr;
+    sorted = nullptr;
+    winners = nullptr;
+    monsters = 0;
+    width = 0;
+    source = 0;
+    head = 0;
+    tail = 0;
+    ordered = false;
+    maxRow = 0;
+    maxCol = 0;
+    sourceRow = -1;
+    sourceCol = -1;
+}
+
+std::uint64_t FlowField::bytes() const {
+    if (!built()) {
+        return 0;
+    }
+    std::uint64_t padded = 1ULL * width * (maxRow + 2);
+    std::uint64_t tiles = 1ULL * maxRow * maxCol;
+    return sizeof(std::uint32_t) * (2 * padded + tiles + 1) + padded
+         + (2 * sizeof(MonsterSpot) + 1) * std::max<std::uint64_t>(monsters, 1);
+}
+
+bool doMonsterChase(char** map, int maxRow, int maxCol, const Player& player, FlowField& flow) {
+    PROFILE_PHASE(PHASE_MONSTER);
+    (void)maxRow;
+    (void)maxCol;
+    flow.update(player);
+    return flow.moveMonsters(map);
+}
+
+bool doMonsterSwarm(char** map, int maxRow, int maxCol, const Player& player, FlowField& flow) {
+    PROFILE_PHASE(PHASE_MONSTER);
+    (void)maxRow;
+    (void)maxCol;
+    flow.update(player);
+    return flow.moveMonstersTogether(map);
+}
@@ -0,0 +1,215 @@
+#ifndef FLOWFIELD_H
+#define FLOWFIELD_H
+
+#include <cstddef>
+#include <cstdint>
+#include "logic.h"
+#include "mapmemory.h"
+
+// Flow-field monster AI for a char** map.
+// Instead of charging along the player's row and column, every monster walks one tile
+// down a shared field of path distances to the player, so monsters anywhere on the map
+// find their way around pillars. The field is a breadth-first search from the player
+// over a copy of the map's pillars, padded with a blocked border so neighbours need no
+// bounds checks. Only pillars block it, so it depends on nothing but the player's tile.
+// The search is lazy and kept between queries: a distance query settles tiles only until
+// it reaches the queried one, and a player move starts a new search by clearing just
+// the tiles the last one settled. A turn therefore costs the area out to the farthest
+// tile queried, not the map; tiles walled off from the player are known from their
+// connected component and never searched for. Monsters are kept in a packed
+// position list ordered nearest first, so a queue of monsters in a corridor advances
+// together and the map is never scanned for them. doMonsterSwarm instead moves them
+// all at once from the map as it was at the start of the turn, which needs no order
+// and splits across threads on large maps. Build the field after loadLevel and again
+// after every resizeMap. Storage comes from tracked map memory, in two blocks.
+
+// distance of pillar and border tiles
+const std::uint32_t FLOW_BLOCKED = ~std::uint32_t(0);
+
+// distance of tiles the player cannot reach
+const std::uint32_t FLOW_UNREACHED = FLOW_BLOCKED - 1;
+
+// position of one monster
+struct MonsterSpot {
+    int row;
+    int col;
+    std::uint32_t distance; // distance to the player as of the last update
+};
+
+/**
+ * Map memory a field of a map with up to the given number of tiles can take, counting
+ * the block headers and arena alignment. A single row is the worst case for the border.
+ * @param   tiles       Number of tiles.
+ * @return  bytes of both blocks.
+ */
+constexpr std::size_t flowFieldBytes(std::size_t tiles) {
+    return (MAP_HEADER_BYTES + (2 * 4 + 1) * 3 * (tiles + 2) + 4 * (tiles + 1) + 15) / 16 * 16
+         + (MAP_HEADER_BYTES + (2 * sizeof(MonsterSpot) + 1) * (tiles > 0 ? tiles : 1) + 15) / 16 * 16;
+}
+
+class FlowField {
+public:
+    FlowField() = default;
+    ~FlowField();
+    FlowField(const FlowField&) = delete;
+    FlowField& operator=(const FlowField&) = delete;
+
+    /**
+     * Copy the pillars, label the connected open areas and list the monsters of a map,
+     * releasing the current field. The search starts at the first update.
+     * @param   map         Dungeon map.
+     * @param   maxRow      Number of rows.
+     * @param   maxCol      Number of columns.
+     * @return  true on success, false if the size is invalid or exceeds the memory budget.
+     */
+    bool build(char** map, int maxRow, int maxCol);
+
+    /**
+     * Lead the field to the player's tile, starting a new search if the player has
+     * moved. Nothing is settled until a distance is queried.
+     * @param   player      Player object for the current location.
+     * @return None
+     */
+    void follow(const Player& player);
+
+    /**
+     * Follow the player and order the monsters nearest first. Settles the field out to the
+     * farthest monster the player can reach.
+     * @param   player      Player object for the current location.
+     * @return None
+     */
+    void update(const Player& player);
+
+    /**
+     * Move every monster one tile down the field, nearest first. A monster takes the
+     * first free neighbour, in up, left, right, down order, that is one step closer;
+     * if they are all taken by monsters it waits. It swaps places with whatever is on
+     * that tile, as in doMonsterAttack, and replaces the player.
+     * @param   map         Dungeon map the field was built for.
+     * @return  true if a monster reaches the player, false if not.
+     * @update map contents
+     */
+    bool moveMonsters(char** map);
+
+    /**
+     * Move every monster one tile down the field at once. Each monster picks its step
+     * as moveMonsters does, but from the map as it was at the start of the turn, so it
+     * never follows into a tile another monster leaves this turn. When several monsters
+     * pick the same tile, the first of them in up, left, right, down order around that
+     * tile moves and the others wait. The result depends neither on the order of the
+     * monsters nor on the number of threads sharing the work on large maps.
+     * @param   map         Dungeon map the field was built for.
+     * @return  true if a monster reaches the player, false if not.
+     * @update map contents
+     */
+    bool moveMonstersTogether(char** map);
+
+    /**
+     * Account for a tile changed outside moveMonsters. Only placing or removing a pillar
+     * changes the field; it relabels the open areas and restarts the search. Monsters
+     * must not be added or removed; rebuild the field for that.
+     * @param   row         Row of the tile.
+     * @param   col         Column of the tile.
+     * @param   before      Tile before the change.
+     * @param   after       Tile after the change.
+     * @return None
+     */
+    void retile(int row, int col, char before, char after);
+
+    /**
+     * Free the field. Call it before the room arena the field came from is reset.
+     * @return None
+     */
+    void release();
+
+    // whether build succeeded and the field has not been released since
+    bool built() const { return distances != nullptr; }
+
+    /**
+     * Path distance from a tile to the player of the last update, searching only as
+     * far as the tile.
+     * @param   row         Row of the tile.
+     * @param   col         Column of the tile.
+     * @return  number of steps, FLOW_BLOCKED on pillars, FLOW_UNREACHED if walled off
+     *          or before the first update.
+     */
+    std::uint32_t distance(int row, int col);
+
+    // number of monsters on the map
+    std::size_t monsterCount() const { return monsters; }
+
+    // number of tiles the current search has settled
+    std::uint32_t settled() const { return tail; }
+
+    // bytes held by the field
+    std::uint64_t bytes() const;
+
+private:
+    // index of a tile in the padded grid
+    std::uint32_t tile(int row, int col) const {
+        return static_cast<std::uint32_t>(row + 1) * width + static_cast<std::uint32_t>(col + 1);
+    }
+
+    // label every open area, numbering them from 1
+    void labelComponents();
+
+    // continue the search until it has found a tile of the player's area
+    void searchTo(std::uint32_t target);
+
+    // clear the distances the current search has settled
+    void forget();
+
+    // start a new search from the player's tile
+    void restart();
+
+    // sort again on the next update if a monster that waited is now behind one that stepped
+    void checkOrder();
+
+    std::uint32_t* distances = nullptr;     // (maxRow + 2) x (maxCol + 2), row-major
+    std::uint32_t* components = nullptr;    // open area of each tile, 0 on pillars and the border
+    std::uint32_t* queue = nullptr;         // tiles found by the search, in order
+    std::uint8_t* proposals = nullptr;      // step picked on each monster tile, 1 to 4, else 0
+    MonsterSpot* spots = nullptr;           // monsters, nearest first once updated
+    MonsterSpot* sorted = nullptr;          // room for reordering spots
+    std::uint8_t* winners = nullptr;        // whether each monster won its tile this turn
+    std::size_t monsters = 0;
+    std::uint32_t width = 0;                // maxCol + 2
+    std::uint32_t source = 0;               // tile the current search started from
+    std::uint32_t head = 0;                 // next tile of the queue to expand
+    std::uint32_t tail = 0;                 // end of the queue
+    bool ordered = false;                   // whether the monsters are ordered for this search
+    int maxRow = 0;
+    int maxCol = 0;
+    int sourceRow = -1;
+    int sourceCol = -1;
+};
+
+/**
+ * Update monster locations by flow field instead of line of sight: the field is brought
+ * up to date for the player, then every monster steps toward the player along a
+ * shortest path around the pillars.
+ * @param   map         Dungeon map the field was built for.
+ * @param   maxRow      Number of rows in the dungeon table (aka height).
+ * @param   maxCol      Number of columns in the dungeon table (aka width).
+ * @param   player      Player object by reference for current location.
+ * @param   flow        Field of the map.
+ * @return  true if a monster reaches the player, false if not.
+ * @update map contents, flow
+ */
+bool doMonsterChase(char** map, int maxRow, int maxCol, const Player& player, FlowField& flow);
+
+/**
+ * Update monster locations by flow field, moving every monster at once as
+ * FlowField::moveMonstersTogether describes. Large maps share the moves across threads;
+ * the result is the same for any number of them.
+ * @param   map         Dungeon map the field was built for.
+ * @param   maxRow      Number of rows in the dungeon table (aka height).
+ * @param   maxCol      Number of columns in the dungeon table (aka width).
+ * @param   player      Player object by reference for current location.
+ * @param   flow        Field of the map.
+ * @return  true if a monster reaches the player, false if not.
+ * @update map contents, flow
+ */
+bool doMonsterSwarm(char** map, int maxRow, int maxCol, const Player& player, FlowField& flow);
+
+#endif
@@ -1,5 +1,6 @@
 #include <iostream>
 #include "helper.h"
+#include "profile.h"
 using std::cout, std::endl;
 
 
@@ -27,9 +28,13 @@ void printInstructions() {
 
 
 void outputMap(char** map, const int maxRow, const int maxCol) {
+    PROFILE_PHASE(PHASE_RENDER);
+    // each line is the borders, DISPLAY_WIDTH characters per tile and a newline
+    PROFILE_COUNT(COUNTER_BYTES_RENDERED, (maxRow + 2LL) * (maxCol * 1LL * DISPLAY_WIDTH + 3));
+
     // output top border
     cout << "+";
-    for (int i = 0; i < maxCol * DISPLAY_WIDTH; ++i) {
+    for (long long i = 0; i < maxCol * 1LL * DISPLAY_WIDTH; ++i) {
         cout << "-";
     }
     cout << "+";
@@ -58,7 +63,7 @@ void outputMap(char** map, const int maxRow, const int maxCol) {
     
     // output bottom border
     cout << "+";
-    for (int i = 0; i < maxCol * DISPLAY_WIDTH; ++i) {
+    for (long long i = 0; i < maxCol * 1LL * DISPLAY_WIDTH; ++i) {
         cout << "-";
     }
     cout << "+";
@@ -0,0 +1,258 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "log.h"
+using std::endl, std::string;
+
+thread_local LogRing* logLocal = nullptr;
+
+// first bytes of a binary log
+const char LOG_BINARY_MAGIC[] = "DLOG1\n";
+
+// how long the writer thread sleeps between passes
+const std::chrono::milliseconds LOG_WRITER_PERIOD(10);
+
+const char* logLevelName(int level) {
+    switch (level) {
+        case LOG_LEVEL_DEBUG: return "DEBUG";
+        case LOG_LEVEL_INFO:  return "INFO";
+        case LOG_LEVEL_WARN:  return "WARN";
+        case LOG_LEVEL_ERROR: return "ERROR";
+        default:              return "?";
+    }
+}
+
+namespace {
+
+void formatRecord(std::ostream& out, int level, const char* function, int line,
+                  const char* expression, const LogValue& value) {
+    out << "[" << logLevelName(level) << "] (" << function << ":" << line << ") " << expression << " = ";
+    switch (value.type) {
+        case LogValue::BOOL:   out << value.b; break;
+        case LogValue::CHAR:   out << value.c; break;
+        case LogValue::INT:    out << value.i; break;
+        case LogValue::UINT:   out << value.u; break;
+        case LogValue::DOUBLE: out << value.d; break;
+        case LogValue::TEXT:   out << value.text; break;
+    }
+    out << '\n';
+}
+
+template<class T>
+void writeBinary(std::FILE* file, const T& value) {
+    std::fwrite(&value, sizeof(value), 1, file);
+}
+
+void writeBinaryText(std::FILE* file, const char* text) {
+    std::uint16_t length = std::strlen(text);
+    writeBinary(file, length);
+    std::fwrite(text, 1, length, file);
+}
+
+template<class T>
+bool readBinary(std::ifstream& in, T& value) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+bool readBinaryText(std::ifstream& in, string& text) {
+    std::uint16_t length = 0;
+    if (!readBinary(in, length)) {
+        return false;
+    }
+    text.resize(length);
+    return static_cast<bool>(in.read(&text[0], length));
+}
+
+// owns the rings and the writer thread
+struct Logger {
+    std::mutex ringsLock;
+    std::vector<std::unique_ptr<LogRing>> rings;
+
+    // held while records are taken off the rings and written
+    std::mutex drainLock;
+    std::ofstream textFile;
+    std::ostream* text = &std::cerr;
+    std::FILE* binary = nullptr;
+    std::unordered_map<const LogSite*, std::uint32_t> siteIds;
+
+    std::mutex wakeLock;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::thread writer;
+
+    Logger() {
+        const char* binaryName = std::getenv("DUNGEON_LOG_BINARY");
+        const char* textName = std::getenv("DUNGEON_LOG_FILE");
+        if (binaryName != nullptr) {
+            binary = std::fopen(binaryName, "wb");
+            if (binary == nullptr) {
+                std::cerr << "Error: File unable to open: " << binaryName << endl;
+            } else {
+                std::fwrite(LOG_BINARY_MAGIC, 1, sizeof(LOG_BINARY_MAGIC) - 1, binary);
+            }
+        } else if (textName != nullptr) {
+            textFile.open(textName);
+            if (textFile.is_open()) {
+                text = &textFile;
+            } else {
+                std::cerr << "Error: File unable to open: " << textName << endl;
+            }
+        }
+        writer = std::thread([this] { run(); });
+    }
+
+    // records still queued at exit are written before the program ends
+    ~Logger() {
+        {
+            std::lock_guard<std::mutex> guard(wakeLock);
+            stopping = true;
+        }
+        wake.notify_one();
+        writer.join();
+        drain();
+        if (binary != nullptr) {
+            std::fclose(binary);
+        }
+        text->flush();
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> guard(wakeLock);
+        while (!stopping) {
+            wake.wait_for(guard, LOG_WRITER_PERIOD);
+            guard.unlock();
+            drain();
+            guard.lock();
+        }
+    }
+
+    void drain() {
+        std::lock_guard<std::mutex> drainGuard(drainLock);
+        std::lock_guard<std::mutex> ringsGuard(ringsLock);
+        for (const std::unique_ptr<LogRing>& ring : rings) {
+            std::uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+            std::uint64_t head = ring->head.load(std::memory_order_acquire);
+            for (; tail < head; ++tail) {
+                write(ring->records[tail % LOG_RING_RECORDS]);
+            }
+            ring->tail.store(tail, std::memory_order_release);
+
+            std::uint64_t dropped = ring->dropped.exchange(0, std::memory_order_relaxed);
+            if (dropped > 0) {
+                static const LogSite droppedSite = {LOG_LEVEL_WARN, "logWrite", __LINE__, "dropped records"};
+                write(LogRecord{readTicks(), &droppedSite, LogValue(dropped)});
+            }
+        }
+        if (binary != nullptr) {
+            std::fflush(binary);
+        } else {
+            text->flush();
+        }
+    }
+
+    void write(const LogRecord& record) {
+        const LogSite* site = record.site;
+        if (binary == nullptr) {
+            formatRecord(*text, site->level, site->function, site->line, site->expression, record.value);
+            return;
+        }
+
+        auto found = siteIds.find(site);
+        std::uint32_t id = 0;
+        if (found == siteIds.end()) {
+            id = siteIds.size();
+            siteIds[site] = id;
+            std::fputc('S', binary);
+            writeBinary(binary, id);
+            writeBinary(binary, static_cast<std::int32_t>(site->level));
+            writeBinary(binary, static_cast<std::int32_t>(site->line));
+            writeBinaryText(binary, site->function);
+            writeBinaryText(binary, site->expression);
+        } else {
+            id = found->second;
+        }
+        std::fputc('R', binary);
+        writeBinary(binary, record.ticks);
+        writeBinary(binary, id);
+        writeBinary(binary, record.value);
+    }
+};
+
+Logger& logger() {
+    static Logger instance;
+    return instance;
+}
+
+}
+
+LogRing* logRegisterThread() {
+    Logger& l = logger();
+    std::unique_ptr<LogRing> ring(new LogRing);
+    std::lock_guard<std::mutex> guard(l.ringsLock);
+    logLocal = ring.get();
+    l.rings.push_back(std::move(ring));
+    return logLocal;
+}
+
+void logFlush() {
+    logger().drain();
+}
+
+bool logDecode(const string& fileName, std::ostream& out) {
+    std::ifstream in(fileName, std::ios::binary);
+    if (!in.is_open()) {
+        std::cerr << "Error: File unable to open: " << fileName << endl;
+        return false;
+    }
+    char magic[sizeof(LOG_BINARY_MAGIC) - 1];
+    if (!in.read(magic, sizeof(magic)) || string(magic, sizeof(magic)) != LOG_BINARY_MAGIC) {
+        std::cerr << "Error: " << fileName << " is not a binary log" << endl;
+        return false;
+    }
+
+    struct Site {
+        std::int32_t level = 0;
+        std::int32_t line = 0;
+        string function;
+        string expression;
+    };
+    std::vector<Site> sites;
+    int tag = 0;
+    while ((tag = in.get()) != EOF) {
+        if (tag == 'S') {
+            std::uint32_t id = 0;
+            Site site;
+            if (!readBinary(in, id) || !readBinary(in, site.level) || !readBinary(in, site.line) ||
+                !readBinaryText(in, site.function) || !readBinaryText(in, site.expression)) {
+                break;
+            }
+            if (id >= sites.size()) {
+                sites.resize(id + 1);
+            }
+            sites[id] = site;
+        } else if (tag == 'R') {
+            std::uint64_t ticks = 0;
+            std::uint32_t id = 0;
+            LogValue value;
+            if (!readBinary(in, ticks) || !readBinary(in, id) || !readBinary(in, value) || id >= sites.size()) {
+                break;
+            }
+            const Site& site = sites[id];
+            formatRecord(out, site.level, site.function.c_str(), site.line, site.expression.c_str(), value);
+        } else {
+            break;
+        }
+    }
+    if (!in.eof()) {
+        std::cerr << "Error: " << fileName << " is corrupt" << endl;
+        return false;
+    }
+    return true;
+}
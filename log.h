@@ -0,0 +1,175 @@
+#ifndef LOG_H
+#define LOG_H
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include "ticks.h"
+
+// Asynchronous logging of "expression = value" records.
+// Call sites only copy the value into the calling thread's ring buffer; a background
+// thread formats the records and writes them to cerr, to $DUNGEON_LOG_FILE, or in binary
+// form to $DUNGEON_LOG_BINARY (decoded by logdump). Records below DUNGEON_LOG_LEVEL are
+// removed by the preprocessor, so disabled call sites generate no code. The default level
+// is LOG_LEVEL_OFF; build with e.g. -DDUNGEON_LOG_LEVEL=LOG_LEVEL_DEBUG and link log.cpp.
+
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO  1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_ERROR 3
+#define LOG_LEVEL_OFF   4
+
+#ifndef DUNGEON_LOG_LEVEL
+#define DUNGEON_LOG_LEVEL LOG_LEVEL_OFF
+#endif
+
+// records kept per thread before the call sites start dropping them
+const std::uint64_t LOG_RING_RECORDS = 1 << 14;
+
+// longest string copied into a record, longer strings are truncated
+const int LOG_TEXT_LENGTH = 15;
+
+// printable level name
+const char* logLevelName(int level);
+
+// static description of one call site
+struct LogSite {
+    int level;
+    const char* function;
+    int line;
+    const char* expression;
+};
+
+// logged value, copied at the call site and formatted later
+struct LogValue {
+    enum Type : std::uint8_t { BOOL, CHAR, INT, UINT, DOUBLE, TEXT };
+    Type type;
+    union {
+        bool b;
+        char c;
+        std::int64_t i;
+        std::uint64_t u;
+        double d;
+        char text[LOG_TEXT_LENGTH + 1];
+    };
+
+    LogValue() : type(INT), i(0) {}
+    LogValue(bool value) : type(BOOL), b(value) {}
+    LogValue(char value) : type(CHAR), c(value) {}
+    LogValue(double value) : type(DOUBLE), d(value) {}
+    LogValue(float value) : type(DOUBLE), d(value) {}
+    LogValue(const char* value) : type(TEXT) {
+        value = value != nullptr ? value : "(null)";
+        copyText(value, std::strlen(value));
+    }
+    LogValue(const std::string& value) : type(TEXT) { copyText(value.data(), value.size()); }
+    template<class T, typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value, int>::type = 0>
+    LogValue(T value) : type(INT), i(value) {}
+    template<class T, typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value, int>::type = 0>
+    LogValue(T value) : type(UINT), u(value) {}
+    template<class T, typename std::enable_if<std::is_enum<T>::value, int>::type = 0>
+    LogValue(T value) : type(INT), i(static_cast<std::int64_t>(value)) {}
+
+    void copyText(const char* value, size_t length) {
+        length = length < LOG_TEXT_LENGTH ? length : LOG_TEXT_LENGTH;
+        std::memcpy(text, value, length);
+        text[length] = '\0';
+    }
+};
+
+// one queued record
+struct LogRecord {
+    std::uint64_t ticks;
+    const LogSite* site;
+    LogValue value;
+};
+
+// single-producer single-consumer queue between one thread and the writer thread
+struct LogRing {
+    alignas(64) std::atomic<std::uint64_t> head{0};
+    alignas(64) std::atomic<std::uint64_t> tail{0};
+    std::atomic<std::uint64_t> dropped{0};
+    LogRecord records[LOG_RING_RECORDS];
+};
+
+// calling thread's ring, or nullptr until it logs its first record
+extern thread_local LogRing* logLocal;
+
+/**
+ * Allocate and register the calling thread's ring, starting the writer thread if needed.
+ * @return  the new ring, also stored in logLocal.
+ */
+LogRing* logRegisterThread();
+
+/**
+ * Write everything queued so far before returning.
+ * @return None
+ */
+void logFlush();
+
+/**
+ * Print a binary log written through $DUNGEON_LOG_BINARY as text.
+ * @param   fileName    Binary log file.
+ * @param   out         Destination stream.
+ * @return  true if the whole file was decoded.
+ */
+bool logDecode(const std::string& fileName, std::ostream& out);
+
+/**
+ * Queue a record without blocking. The record is dropped, and counted, if the ring is full.
+ * @param   site        Call site description.
+ * @param   value       Logged value.
+ * @return None
+ */
+inline void logWrite(const LogSite* site, const LogValue& value) {
+    LogRing* ring = logLocal;
+    if (ring == nullptr) {
+        ring = logRegisterThread();
+    }
+    std::uint64_t head = ring->head.load(std::memory_order_relaxed);
+    if (head - ring->tail.load(std::memory_order_acquire) >= LOG_RING_RECORDS) {
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    LogRecord& record = ring->records[head % LOG_RING_RECORDS];
+    record.ticks = readTicks();
+    record.site = site;
+    record.value = value;
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+#define LOG_RECORD(LEVEL, X) do { \
+        static const LogSite logSite = {LEVEL, __FUNCTION__, __LINE__, #X}; \
+        logWrite(&logSite, LogValue(X)); \
+    } while (0)
+
+#if DUNGEON_LOG_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(X) LOG_RECORD(LOG_LEVEL_DEBUG, X)
+#else
+#define LOG_DEBUG(X) do {} while (0)
+#endif
+
+#if DUNGEON_LOG_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(X) LOG_RECORD(LOG_LEVEL_INFO, X)
+#else
+#define LOG_INFO(X) do {} while (0)
+#endif
+
+#if DUNGEON_LOG_LEVEL <= LOG_LEVEL_WARN
+#define LOG_WARN(X) LOG_RECORD(LOG_LEVEL_WARN, X)
+#else
+#define LOG_WARN(X) do {} while (0)
+#endif
+
+#if DUNGEON_LOG_LEVEL <= LOG_LEVEL_ERROR
+#define LOG_ERROR(X) LOG_RECORD(LOG_LEVEL_ERROR, X)
+#else
+#define LOG_ERROR(X) do {} while (0)
+#endif
+
+// the original debugging macro, now asynchronous
+#define INFO(X) LOG_INFO(X)
+
+#endif
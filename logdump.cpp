@@ -0,0 +1,14 @@
+// Prints a binary log written by log.cpp as text.
+// Build:  g++ -std=c++17 -O2 logdump.cpp log.cpp -o logdump -pthread
+// Usage:  ./logdump FILE
+#include <iostream>
+#include "log.h"
+using std::cout, std::cerr, std::endl;
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        cerr << "Usage: " << argv[0] << " FILE" << endl;
+        return 1;
+    }
+    return logDecode(argv[1], cout) ? 0 : 1;
+}
@@ -2,10 +2,20 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstring>
 #include "logic.h"
+#include "profile.h"
+#include "mapmemory.h"
+#include "parallel.h"
 
 using std::cout, std::endl, std::ifstream, std::string;
 
+// size of the stack buffer loadLevel reads the level file through
+const int LOAD_BUFFER_BYTES = 4096;
+
 /**
  * Load representation of the dungeon level from file into the 2D map.
  * Calls createMap to allocate the 2D array.
@@ -17,7 +27,12 @@ using std::cout, std::endl, std::ifstream, std::string;
  * @updates  maxRow, maxCol, player
  */
 char** loadLevel(const string& fileName, int& maxRow, int& maxCol, Player& player) {
-    ifstream ifs(fileName);
+    PROFILE_PHASE(PHASE_LOAD);
+    // a stack buffer keeps the stream from allocating one on the heap
+    char buffer[LOAD_BUFFER_BYTES];
+    ifstream ifs;
+    ifs.rdbuf()->pubsetbuf(buffer, sizeof(buffer));
+    ifs.open(fileName);
     if(!ifs.is_open()) {
         cout << "Error: File unable to open: " << fileName << endl;
         return nullptr;
@@ -71,25 +86,137 @@ void getDirection(char input, int& nextRow, int& nextCol) {
     
 }
 
+/**
+ * Bytes taken by the tiles of a map, rounded up so the row pointer array after them is aligned.
+ * @param   maxRow      Number of rows in the dungeon table (aka height).
+ * @param   maxCol      Number of columns in the dungeon table (aka width).
+ * @return  offset of the row pointer array in the map's block.
+ */
+static std::size_t tileBytes(std::int64_t maxRow, std::int64_t maxCol) {
+    std::size_t bytes = static_cast<std::size_t>(maxRow) * static_cast<std::size_t>(maxCol);
+    return (bytes + alignof(char*) - 1) / alignof(char*) * alignof(char*);
+}
+
+/**
+ * Size of the block holding a map, checked for overflow. Tile counts and byte sizes
+ * are 64-bit throughout, so a map may hold more than 2^31 tiles; only each dimension
+ * is limited to INT_MAX by the int signatures.
+ * @param   maxRow      Number of rows in the dungeon table (aka height).
+ * @param   maxCol      Number of columns in the dungeon table (aka width).
+ * @param   bytes       Size of the tiles and the row pointer array.
+ * @return  false if a dimension is out of range or the size does not fit in size_t.
+ * @update bytes
+ */
+static bool mapBlockBytes(std::int64_t maxRow, std::int64_t maxCol, std::size_t& bytes) {
+    if((maxRow <= 0) || (maxCol <= 0) || (maxRow > INT_MAX) || (maxCol > INT_MAX)) {
+        return false;
+    }
+    std::size_t tiles = 0;
+    std::size_t pointers = 0;
+    // leave room for the alignment padding and the block header mapAlloc adds
+    if(__builtin_mul_overflow(static_cast<std::size_t>(maxRow), static_cast<std::size_t>(maxCol), &tiles) ||
+       __builtin_mul_overflow(static_cast<std::size_t>(maxRow), sizeof(char*), &pointers) ||
+       __builtin_add_overflow(tiles, pointers + 2 * alignof(char*) + MAP_HEADER_BYTES, &bytes)) {
+        return false;
+    }
+    bytes = tileBytes(maxRow, maxCol) + pointers;
+    return true;
+}
+
+/**
+ * Point the row pointer array of a map's block at its rows.
+ * @param   tiles       Start of the block, holding the rows back to back.
+ * @param   maxRow      Number of rows in the dungeon table (aka height).
+ * @param   maxCol      Number of columns in the dungeon table (aka width).
+ * @return  2D map array.
+ */
+static char** buildRows(char* tiles, std::int64_t maxRow, std::int64_t maxCol) {
+    char** rows = reinterpret_cast<char**>(tiles + tileBytes(maxRow, maxCol));
+    for(std::int64_t i = 0; i < maxRow; i++) {
+        rows[i] = tiles + i * maxCol;
+    }
+    return rows;
+}
+
+/**
+ * Allocate a map as one block from tracked map memory: the rows back to back,
+ * followed by the row pointer array. The tiles are left uninitialized.
+ * @param   maxRow      Number of rows in the dungeon table (aka height).
+ * @param   maxCol      Number of columns in the dungeon table (aka width).
+ * @return  2D map array, or nullptr if the size is invalid, overflows or exceeds the memory budget.
+ */
+static char** allocateMap(std::int64_t maxRow, std::int64_t maxCol) {
+    std::size_t bytes = 0;
+    if(!mapBlockBytes(maxRow, maxCol, bytes) || !mapMemoryFits(bytes)) {
+        return nullptr;
+    }
+
+    char* tiles = static_cast<char*>(mapAlloc(bytes));
+    if(tiles == nullptr) {
+        return nullptr;
+    }
+    return buildRows(tiles, maxRow, maxCol);
+}
+
+/**
+ * Double a map inside its own block, if the block can grow without copying.
+ * Rows spread out from the back in waves: the rows of each wave move to where no
+ * row still waiting to move is stored, so a wave can be copied in parallel.
+ * @param   map         Dungeon map allocated by allocateMap, player tile already cleared.
+ * @param   maxRow      Number of rows in the dungeon table (aka height).
+ * @param   maxCol      Number of columns in the dungeon table (aka width).
+ * @param   bytes       Block size of the doubled map, from mapBlockBytes.
+ * @return  the doubled map, or nullptr if the block cannot grow in place.
+ */
+static char** growMapInPlace(char** map, std::int64_t maxRow, std::int64_t maxCol, std::size_t bytes) {
+    std::size_t rowBytes = maxCol;
+    char* tiles = static_cast<char*>(mapExtend(map[0], bytes));
+    if(tiles == nullptr) {
+        return nullptr;
+    }
+
+    // row i moves from i * rowBytes to i * 2 * rowBytes and is copied once to its right
+    for(std::int64_t last = maxRow; last > 1; ) {
+        std::int64_t first = (last + 1) / 2;
+        parallelFor(last - first, 4 * rowBytes, [&](std::size_t begin, std::size_t end) {
+            for(std::size_t i = first + begin; i < first + end; i++) {
+                char* row = tiles + i * 2 * rowBytes;
+                std::memcpy(row, tiles + i * rowBytes, rowBytes);
+                std::memcpy(row + rowBytes, row, rowBytes);
+            }
+        });
+        last = first;
+    }
+    std::memcpy(tiles + rowBytes, tiles, rowBytes);
+
+    // the bottom half repeats the top half
+    char* bottom = tiles + maxRow * 2 * rowBytes;
+    parallelFor(maxRow, 4 * rowBytes, [&](std::size_t begin, std::size_t end) {
+        std::memcpy(bottom + begin * 2 * rowBytes, tiles + begin * 2 * rowBytes, (end - begin) * 2 * rowBytes);
+    });
+    return buildRows(tiles, 2 * maxRow, 2 * maxCol);
+}
+
 /**
  * Allocate the 2D map array.
  * Initialize each cell to TILE_OPEN.
  * @param   maxRow      Number of rows in the dungeon table (aka height).
  * @param   maxCol      Number of columns in the dungeon table (aka width).
- * @return  2D map array for the dungeon level, holds char type.
+ * @return  2D map array for the dungeon level, holds char type, or nullptr if it exceeds the memory budget.
  */
 char** createMap(int maxRow, int maxCol) {
-    char** diffMap = new char*[maxRow];
+    char** diffMap = allocateMap(maxRow, maxCol);
 
-    for(int i = 0; i < maxRow; i++){
-        diffMap[i] = new char[maxCol];
+    if(diffMap == nullptr) {
+        return nullptr;
     }
 
-    for(int i = 0; i < maxRow; i++){
-        for(int j = 0; j < maxCol; j++){
-            diffMap[i][j] = TILE_OPEN;
-        }
-    }
+    // the threads touch the pages first, so a large map is faulted in (and backed by
+    // huge pages) in parallel rather than on the thread that reads the level
+    std::size_t rowBytes = maxCol;
+    parallelFor(maxRow, rowBytes, [&](std::size_t begin, std::size_t end) {
+        std::memset(diffMap[begin], TILE_OPEN, (end - begin) * rowBytes);
+    });
 
     return diffMap;
 }
@@ -103,11 +230,11 @@ char** createMap(int maxRow, int maxCol) {
  */
 void deleteMap(char**& map, int& maxRow) {
 
-    for(int j = 0; j < maxRow; j++) {
-		delete[] map[j];
-	}
-
-	delete[] map;
+    // the rows and the row pointer array share one block, which starts at the first row
+    if((map == nullptr) || (maxRow <= 0)) {
+        return;
+    }
+	mapFree(map[0]);
 }
 
 /**
@@ -118,43 +245,75 @@ void deleteMap(char**& map, int& maxRow) {
  * @param   map         Dungeon map.
  * @param   maxRow      Number of rows in the dungeon table (aka height), to be doubled.
  * @param   maxCol      Number of columns in the dungeon table (aka width), to be doubled.
- * @return  pointer to a dynamically-allocated 2D array (map) that has twice as many columns and rows in size.
+ * @return  pointer to a dynamically-allocated 2D array (map) that has twice as many columns and rows in size,
+ *          or the unchanged map if the larger map would exceed the memory budget.
  * @update maxRow, maxCol
  */
 char** resizeMap(char** map, int& maxRow, int& maxCol) {
-    int tempRow = 2*maxRow;
-    int tempCol = 2*maxCol;
-    char **resize = new char*[tempRow];
-
-    for(int i = 0; i < tempRow; i++) {
-        char* temp = new char[tempCol];
-        resize[i] = temp;
-    }
-
-    int curRow = 0;
-    int curCol = 0;
+    Player player;
 
     for(int i = 0; i < maxRow; i++) {
         for(int j = 0; j < maxCol; j++) {
             if(map[i][j] == 'o') {
-                curRow = i;
-                curCol = j;
+                player.row = i;
+                player.col = j;
             }
         }
     }
-    map[curRow][curCol] = TILE_OPEN;
 
-    for(int i = 0; i < tempRow; i++) {
-        for(int j = 0; j < tempCol; j++) {
-            resize[i][j] = map[i%maxRow][j%maxCol];
-        }
+    return resizeMap(map, maxRow, maxCol, player);
+}
+
+/**
+ * Resize the 2D map by doubling both dimensions, using the player's known position
+ * instead of scanning for it. Mapped blocks grow in place; other maps are copied
+ * row by row into a new block. Large maps are copied on several threads.
+ * @param   map         Dungeon map.
+ * @param   maxRow      Number of rows in the dungeon table (aka height), to be doubled.
+ * @param   maxCol      Number of columns in the dungeon table (aka width), to be doubled.
+ * @param   player      Player object whose position is on the map.
+ * @return  pointer to a 2D array (map) that has twice as many columns and rows in size,
+ *          or the unchanged map if the larger map would exceed the memory budget or
+ *          a dimension would pass INT_MAX.
+ * @update maxRow, maxCol
+ */
+char** resizeMap(char** map, int& maxRow, int& maxCol, const Player& player) {
+    PROFILE_PHASE(PHASE_RESIZE);
+    std::int64_t tempRow = 2LL * maxRow;
+    std::int64_t tempCol = 2LL * maxCol;
+    std::size_t rowBytes = maxCol;
+
+    // a doubled dimension past INT_MAX, or a block past size_t, keeps the current map
+    std::size_t bytes = 0;
+    if(!mapBlockBytes(tempRow, tempCol, bytes)) {
+        return map;
     }
-    resize[curRow][curCol] = 'o';
 
-    deleteMap(map, maxRow);
+    map[player.row][player.col] = TILE_OPEN;
+
+    char** resize = growMapInPlace(map, maxRow, maxCol, bytes);
+    if(resize == nullptr) {
+        resize = allocateMap(tempRow, tempCol);
+
+        // over the memory budget, keep the current map
+        if(resize == nullptr) {
+            map[player.row][player.col] = TILE_PLAYER;
+            return map;
+        }
+
+        parallelFor(maxRow, 4 * rowBytes, [&](std::size_t begin, std::size_t end) {
+            for(std::size_t i = begin; i < end; i++) {
+                std::memcpy(resize[i], map[i], rowBytes);
+                std::memcpy(resize[i] + rowBytes, map[i], rowBytes);
+                std::memcpy(resize[i + maxRow], resize[i], 2 * rowBytes);
+            }
+        });
+        deleteMap(map, maxRow);
+    }
+    resize[player.row][player.col] = TILE_PLAYER;
 
-    maxCol = tempCol;
-    maxRow = tempRow;
+    maxCol = static_cast<int>(tempCol);
+    maxRow = static_cast<int>(tempRow);
     
 	return resize;
 }
@@ -176,6 +335,7 @@ char** resizeMap(char** map, int& maxRow, int& maxCol) {
  * @update map contents, player
  */
 int doPlayerMove(char** map, int maxRow, int maxCol, Player& player, int nextRow, int nextCol) {
+    PROFILE_PHASE(PHASE_MOVE);
 
     if((nextRow < 0) || (nextRow >= maxRow)) {
 		nextRow = player.row;
@@ -267,9 +427,11 @@ int doPlayerMove(char** map, int maxRow, int maxCol, Player& player, int nextRow
  * @update map contents
  */
 bool doMonsterAttack(char** map, int maxRow, int maxCol, const Player& player) {
+    PROFILE_PHASE(PHASE_MONSTER);
 
     // CHECKS THE TILE ABOVE
     for(int i = player.col - 1; i >= 0; --i){
+        PROFILE_COUNT(COUNTER_TILES_SCANNED, 1);
         if(map[player.row][i] == TILE_PILLAR){
             break;
         } 
@@ -280,12 +442,14 @@ bool doMonsterAttack(char** map, int maxRow, int maxCol, const Player& player) {
                 stay = TILE_OPEN;
             }
             
+            PROFILE_COUNT(COUNTER_MONSTERS_MOVED, 1);
             map[player.row][i + 1] = map[player.row][i];
             map[player.row][i] = stay;
         }
     }
     // CHECKS THE TILE BELOW
     for(int i = player.col + 1; i < maxCol; ++i){
+        PROFILE_COUNT(COUNTER_TILES_SCANNED, 1);
         if(map[player.row][i] == TILE_PILLAR){
             break;
         } 
@@ -296,12 +460,14 @@ bool doMonsterAttack(char** map, int maxRow, int maxCol, const Player& player) {
                 stay = TILE_OPEN;
             }
             
+            PROFILE_COUNT(COUNTER_MONSTERS_MOVED, 1);
             map[player.row][i - 1] = map[player.row][i];
             map[player.row][i] = stay;
         }
     }
     // CHECKS THE TILE TO THE LEFT
     for(int i = player.row - 1; i >= 0; --i){
+        PROFILE_COUNT(COUNTER_TILES_SCANNED, 1);
         if(map[i][player.col] == TILE_PILLAR){
             break;
         }   
@@ -312,12 +478,14 @@ bool doMonsterAttack(char** map, int maxRow, int maxCol, const Player& player) {
                 stay = TILE_OPEN;
             }
             
+            PROFILE_COUNT(COUNTER_MONSTERS_MOVED, 1);
             map[i + 1][player.col] = map[i][player.col];
             map[i][player.col] = stay;
         }
     }
     // CHECKS THE TILE TO THE RIGHT
     for(int i = player.row + 1; i < maxRow; i++){
+        PROFILE_COUNT(COUNTER_TILES_SCANNED, 1);
         if(map[i][player.col] == TILE_PILLAR){
             break;
         } 
@@ -328,6 +496,7 @@ bool doMonsterAttack(char** map, int maxRow, int maxCol, const Player& player) {
                 stay = TILE_OPEN;
             }
             
+            PROFILE_COUNT(COUNTER_MONSTERS_MOVED, 1);
             map[i - 1][player.col] = map[i][player.col];
             map[i][player.col] = stay;
         }
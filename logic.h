@@ -1,7 +1,6 @@
 #ifndef LOGIC_H
 #define LOGIC_H
 
-#define INFO(X) cout << "[INFO] ("<<__FUNCTION__<<":"<<__LINE__<<") " << #X << " = " << X << endl;
 #include <iostream>
 #include <fstream>
 #include <string>
@@ -72,7 +71,7 @@ void getDirection(char input, int& nextRow, int& nextCol);
  * Initialize each cell to TILE_OPEN.
  * @param   maxRow      Number of rows in the dungeon table (aka height).
  * @param   maxCol      Number of columns in the dungeon table (aka width).
- * @return  2D map array for the dungeon level, holds char type.
+ * @return  2D map array for the dungeon level, holds char type, or nullptr if it exceeds the memory budget.
  */
 char** createMap(int maxRow, int maxCol);
 
@@ -92,11 +91,25 @@ void deleteMap(char**& map, int& maxRow);
  * @param   map         Dungeon map.
  * @param   maxRow      Number of rows in the dungeon table (aka height), to be doubled.
  * @param   maxCol      Number of columns in the dungeon table (aka width), to be doubled.
- * @return  pointer to a dynamically-allocated 2D array (map) that has twice as many columns and rows in size.
+ * @return  pointer to a dynamically-allocated 2D array (map) that has twice as many columns and rows in size,
+ *          or the unchanged map if the larger map would exceed the memory budget.
  * @update maxRow, maxCol
  */
 char** resizeMap(char** map, int& maxRow, int& maxCol);
 
+/**
+ * Resize the 2D map by doubling both dimensions, as resizeMap above, without
+ * scanning the map for the player.
+ * @param   map         Dungeon map.
+ * @param   maxRow      Number of rows in the dungeon table (aka height), to be doubled.
+ * @param   maxCol      Number of columns in the dungeon table (aka width), to be doubled.
+ * @param   player      Player object whose position is on the map.
+ * @return  the doubled map, or the unchanged map if it would exceed the memory budget
+ *          or a dimension would pass INT_MAX.
+ * @update maxRow, maxCol
+ */
+char** resizeMap(char** map, int& maxRow, int& maxCol, const Player& player);
+
 /**
  * Checks if the player can move in the specified direction and performs the move if so.
  * Cannot move out of bounds or onto TILE_PILLAR or TILE_MONSTER.
@@ -0,0 +1,427 @@
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "mapmemory.h"
+#include "arena.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using std::endl;
+
+namespace {
+
+// where a block's memory came from
+enum BlockKind : std::size_t {
+    BLOCK_HEAP,
+    BLOCK_ARENA,
+    BLOCK_MAPPED,
+    BLOCK_HUGETLB
+};
+
+// in front of every block
+struct BlockHeader {
+    std::size_t bytes;
+    BlockKind kind;
+};
+
+const std::size_t HEADER_BYTES = MAP_HEADER_BYTES;
+static_assert(sizeof(BlockHeader) <= HEADER_BYTES, "block header must keep blocks 16-byte aligned");
+
+struct MapMemory {
+    MapMemoryStats total;
+    std::vector<MapMemoryStats> rooms = std::vector<MapMemoryStats>(1);
+    int room = 0;
+    std::uint64_t budget = 0;
+    bool reporting = false;
+    Arena* arena = nullptr;
+    MapPagePolicy pagePolicy = MAP_PAGES_THP;
+
+    MapMemory() {
+        const char* budgetText = std::getenv("DUNGEON_MEMORY_BUDGET");
+        if (budgetText != nullptr) {
+            char* suffix = nullptr;
+            budget = std::strtoull(budgetText, &suffix, 10);
+            switch (*suffix) {
+                case 'G': case 'g': budget <<= 30; break;
+                case 'M': case 'm': budget <<= 20; break;
+                case 'K': case 'k': budget <<= 10; break;
+            }
+        }
+        reporting = std::getenv("DUNGEON_MEMORY_REPORT") != nullptr;
+        const char* pagesText = std::getenv("DUNGEON_HUGE_PAGES");
+        if (pagesText != nullptr) {
+            if (std::strcmp(pagesText, "off") == 0) {
+                pagePolicy = MAP_PAGES_SMALL;
+            } else if (std::strcmp(pagesText, "hugetlb") == 0) {
+                pagePolicy = MAP_PAGES_HUGETLB;
+            }
+        }
+    }
+
+    // the final report is printed when the program exits, whichever way main returns
+    ~MapMemory() {
+        if (reporting) {
+            mapMemoryReport(std::cerr);
+        }
+    }
+};
+
+MapMemory& memory() {
+    static MapMemory instance;
+    return instance;
+}
+
+// count bytes newly held by a heap or mapped block
+void recordGrowth(MapMemory& m, std::size_t bytes, bool newBlock) {
+    for (MapMemoryStats* stats : {&m.total, &m.rooms[m.room]}) {
+        stats->currentBytes += bytes;
+        stats->allocatedBytes += bytes;
+        stats->allocations += newBlock ? 1 : 0;
+        if (stats->currentBytes > stats->peakBytes) {
+            stats->peakBytes = stats->currentBytes;
+        }
+    }
+}
+
+std::size_t roundToHugePage(std::size_t bytes) {
+    return (bytes + MAP_HUGE_PAGE_BYTES - 1) / MAP_HUGE_PAGE_BYTES * MAP_HUGE_PAGE_BYTES;
+}
+
+// bytes the OS mapped for a block, header included
+std::size_t mappedBytes(const BlockHeader& header) {
+    std::size_t bytes = header.bytes + HEADER_BYTES;
+    return header.kind == BLOCK_HUGETLB ? roundToHugePage(bytes) : bytes;
+}
+
+// whether a mapped block of this size gets huge pages under the policy
+bool wantsHugePages(const MapMemory& m, std::size_t bytes) {
+    return m.pagePolicy != MAP_PAGES_SMALL && bytes >= MAP_HUGE_PAGE_BYTES;
+}
+
+#ifdef __linux__
+/**
+ * Map pages aligned to a huge page and advise the kernel to back them with
+ * transparent huge pages. Without the alignment the first and last partial huge
+ * pages of every block would stay small.
+ * @param   bytes       Size of the mapping.
+ * @return  start of the mapping, or nullptr if mapping fails.
+ */
+char* mapAlignedPages(std::size_t bytes) {
+    std::size_t page = sysconf(_SC_PAGESIZE);
+    bytes = (bytes + page - 1) / page * page;
+    std::size_t reserved = bytes + MAP_HUGE_PAGE_BYTES;
+    void* pages = mmap(nullptr, reserved, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pages == MAP_FAILED) {
+        return nullptr;
+    }
+    char* first = static_cast<char*>(pages);
+    std::size_t head = (MAP_HUGE_PAGE_BYTES - reinterpret_cast<std::uintptr_t>(first) % MAP_HUGE_PAGE_BYTES)
+                       % MAP_HUGE_PAGE_BYTES;
+    std::size_t tail = reserved - head - bytes;
+    // give back the pages on either side of the aligned block
+    if (head > 0) {
+        munmap(first, head);
+    }
+    if (tail > 0) {
+        munmap(first + head + bytes, tail);
+    }
+    madvise(first + head, bytes, MADV_HUGEPAGE);
+    return first + head;
+}
+#endif
+
+/**
+ * Map a block straight from the OS, following the page policy for large blocks.
+ * @param   bytes       Size of the mapping.
+ * @param   kind        Set to BLOCK_HUGETLB for reserved huge pages, BLOCK_MAPPED otherwise.
+ * @return  start of the mapping, or nullptr if mapping is unavailable or fails.
+ * @update kind
+ */
+char* mapPages(MapMemory& m, std::size_t bytes, BlockKind& kind) {
+    kind = BLOCK_MAPPED;
+#ifdef __linux__
+    if (!wantsHugePages(m, bytes)) {
+        void* pages = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        return pages == MAP_FAILED ? nullptr : static_cast<char*>(pages);
+    }
+    MapMemoryStats* counted[] = {&m.total, &m.rooms[m.room]};
+    for (MapMemoryStats* stats : counted) {
+        stats->hugeBlocks++;
+    }
+    if (m.pagePolicy == MAP_PAGES_HUGETLB) {
+        void* pages = mmap(nullptr, roundToHugePage(bytes), PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (pages != MAP_FAILED) {
+            kind = BLOCK_HUGETLB;
+            return static_cast<char*>(pages);
+        }
+        for (MapMemoryStats* stats : counted) {
+            stats->hugetlbFallbacks++;
+        }
+    }
+    return mapAlignedPages(bytes);
+#else
+    (void)m;
+    (void)bytes;
+    return nullptr;
+#endif
+}
+
+/**
+ * Sum the huge page sizes of the mappings in a smaps-format file that overlap a range.
+ * @param   path        /proc/self/smaps or /proc/self/smaps_rollup.
+ * @param   low         Start of the range.
+ * @param   high        End of the range.
+ * @return  huge page bytes, 0 if the file cannot be read.
+ */
+std::uint64_t readHugePageBytes(const char* path, std::uintptr_t low, std::uintptr_t high) {
+    std::ifstream smaps(path);
+    std::string line;
+    bool inRange = false;
+    std::uint64_t kilobytes = 0;
+    while (std::getline(smaps, line)) {
+        std::uintptr_t start = 0;
+        std::uintptr_t end = 0;
+        char dash = 0;
+        std::istringstream fields(line);
+        if (fields >> std::hex >> start >> dash >> end && dash == '-') {
+            inRange = start < high && low < end;
+            continue;
+        }
+        std::string name;
+        std::uint64_t size = 0;
+        fields.clear();
+        fields.seekg(0);
+        if (inRange && fields >> name >> std::dec >> size &&
+            (name == "AnonHugePages:" || name == "Private_Hugetlb:" || name == "Shared_Hugetlb:")) {
+            kilobytes += size;
+        }
+    }
+    return kilobytes << 10;
+}
+
+void printStats(std::ostream& out, const MapMemoryStats& stats) {
+    out << "current " << stats.currentBytes << " B, peak " << stats.peakBytes << " B, "
+        << stats.allocations << " allocations (" << stats.allocatedBytes << " B), "
+        << stats.frees << " frees, " << stats.refusals << " refused" << endl;
+}
+
+}
+
+void* mapAlloc(std::size_t bytes) {
+    MapMemory& m = memory();
+    // large blocks are mapped from the OS even in a room, so resizeMap can grow them
+    if (m.arena == nullptr || bytes >= MAP_MMAP_THRESHOLD) {
+        return mapAllocHeap(bytes);
+    }
+    char* block = static_cast<char*>(m.arena->allocate(bytes + HEADER_BYTES));
+    if (block == nullptr) {
+        return nullptr;
+    }
+    *reinterpret_cast<BlockHeader*>(block) = BlockHeader{bytes, BLOCK_ARENA};
+    return block + HEADER_BYTES;
+}
+
+void* mapAllocHeap(std::size_t bytes) {
+    MapMemory& m = memory();
+    MapMemoryStats& room = m.rooms[m.room];
+    if (!mapMemoryFits(bytes)) {
+        return nullptr;
+    }
+    BlockKind kind = BLOCK_HEAP;
+    char* block = nullptr;
+    if (bytes >= MAP_MMAP_THRESHOLD) {
+        block = mapPages(m, bytes + HEADER_BYTES, kind);
+    }
+    if (block == nullptr) {
+        block = static_cast<char*>(::operator new(bytes + HEADER_BYTES, std::nothrow));
+        kind = BLOCK_HEAP;
+    }
+    if (block == nullptr) {
+        m.total.refusals++;
+        room.refusals++;
+        return nullptr;
+    }
+    *reinterpret_cast<BlockHeader*>(block) = BlockHeader{bytes, kind};
+    recordGrowth(m, bytes, true);
+    return block + HEADER_BYTES;
+}
+
+void* mapExtend(void* block, std::size_t bytes) {
+#ifdef __linux__
+    char* start = static_cast<char*>(block) - HEADER_BYTES;
+    BlockHeader header = *reinterpret_cast<BlockHeader*>(start);
+    // reserved huge pages cannot be remapped to a new size
+    if (header.kind != BLOCK_MAPPED || bytes < header.bytes) {
+        return nullptr;
+    }
+    MapMemory& m = memory();
+    if (!mapMemoryFits(bytes - header.bytes)) {
+        return nullptr;
+    }
+    void* moved = MAP_FAILED;
+    if (wantsHugePages(m, bytes + HEADER_BYTES)) {
+        // move the pages into an aligned range, so the grown block keeps its huge pages
+        char* target = mapAlignedPages(bytes + HEADER_BYTES);
+        if (target == nullptr) {
+            return nullptr;
+        }
+        moved = mremap(start, mappedBytes(header), bytes + HEADER_BYTES, MREMAP_MAYMOVE | MREMAP_FIXED, target);
+        if (moved == MAP_FAILED) {
+            munmap(target, bytes + HEADER_BYTES);
+            return nullptr;
+        }
+        madvise(moved, bytes + HEADER_BYTES, MADV_HUGEPAGE);
+        if (header.bytes + HEADER_BYTES < MAP_HUGE_PAGE_BYTES) {
+            m.total.hugeBlocks++;
+            m.rooms[m.room].hugeBlocks++;
+        }
+    } else {
+        moved = mremap(start, mappedBytes(header), bytes + HEADER_BYTES, MREMAP_MAYMOVE);
+        if (moved == MAP_FAILED) {
+            return nullptr;
+        }
+    }
+    start = static_cast<char*>(moved);
+    reinterpret_cast<BlockHeader*>(start)->bytes = bytes;
+    recordGrowth(m, bytes - header.bytes, false);
+    return start + HEADER_BYTES;
+#else
+    (void)block;
+    (void)bytes;
+    return nullptr;
+#endif
+}
+
+void mapFree(void* block) {
+    if (block == nullptr) {
+        return;
+    }
+    MapMemory& m = memory();
+    char* start = static_cast<char*>(block) - HEADER_BYTES;
+    const BlockHeader& header = *reinterpret_cast<BlockHeader*>(start);
+    if (header.kind == BLOCK_ARENA) {
+        // released all at once when the arena is reset
+        return;
+    }
+    std::size_t bytes = header.bytes;
+    BlockKind kind = header.kind;
+    std::size_t mapped = mappedBytes(header);
+    m.total.currentBytes -= bytes;
+    m.total.frees++;
+
+    // a block freed in a later room still counts against the room that is running
+    MapMemoryStats& room = m.rooms[m.room];
+    room.currentBytes = room.currentBytes > bytes ? room.currentBytes - bytes : 0;
+    room.frees++;
+#ifdef __linux__
+    if (kind == BLOCK_MAPPED || kind == BLOCK_HUGETLB) {
+        munmap(start, mapped);
+        return;
+    }
+#endif
+    (void)mapped;
+    ::operator delete(start);
+}
+
+bool mapMemoryFits(std::uint64_t bytes) {
+    MapMemory& m = memory();
+    if (m.budget == 0 || m.total.currentBytes + bytes <= m.budget) {
+        return true;
+    }
+    // space the arena already holds does not count against the budget again; large
+    // blocks never come from the arena
+    if (m.arena != nullptr && bytes < MAP_MMAP_THRESHOLD && bytes <= m.arena->capacity() - m.arena->used()) {
+        return true;
+    }
+    m.total.refusals++;
+    m.rooms[m.room].refusals++;
+    return false;
+}
+
+void setMapMemoryBudget(std::uint64_t bytes) {
+    memory().budget = bytes;
+}
+
+void setMapPagePolicy(MapPagePolicy policy) {
+    memory().pagePolicy = policy;
+}
+
+MapPagePolicy mapPagePolicy() {
+    return memory().pagePolicy;
+}
+
+std::uint64_t mapHugePageBytes(const void* block) {
+    const char* start = static_cast<const char*>(block) - HEADER_BYTES;
+    const BlockHeader& header = *reinterpret_cast<const BlockHeader*>(start);
+    if (header.kind != BLOCK_MAPPED && header.kind != BLOCK_HUGETLB) {
+        return 0;
+    }
+    std::uintptr_t low = reinterpret_cast<std::uintptr_t>(start);
+    std::uint64_t bytes = readHugePageBytes("/proc/self/smaps", low, low + 1);
+    // the block's mapping may have been merged with a neighbouring one
+    return bytes < mappedBytes(header) ? bytes : mappedBytes(header);
+}
+
+void setMapArena(Arena* arena) {
+    memory().arena = arena;
+}
+
+Arena* mapArena() {
+    return memory().arena;
+}
+
+void mapMemoryBeginRoom(int room) {
+    MapMemory& m = memory();
+    if (room >= static_cast<int>(m.rooms.size())) {
+        m.rooms.resize(room + 1);
+    }
+    m.room = room;
+    // storage carried over from the previous room is part of this room's footprint
+    m.rooms[room].currentBytes = m.total.currentBytes;
+    m.rooms[room].peakBytes = m.total.currentBytes;
+}
+
+void mapMemoryEndRoom() {
+    MapMemory& m = memory();
+    if (m.reporting) {
+        std::cerr << "map memory, room " << m.room << ": ";
+        printStats(std::cerr, m.rooms[m.room]);
+        if (m.arena != nullptr) {
+            std::cerr << "room arena: " << m.arena->used() << " B used of " << m.arena->capacity()
+                      << " B in " << m.arena->chunks() << " chunks" << endl;
+        }
+    }
+}
+
+const MapMemoryStats& mapMemoryStats() {
+    return memory().total;
+}
+
+void mapMemoryReport(std::ostream& out) {
+    MapMemory& m = memory();
+    out << "=== map memory ===" << endl;
+    if (m.budget != 0) {
+        out << "budget " << m.budget << " B" << endl;
+    }
+    for (size_t room = 1; room < m.rooms.size(); ++room) {
+        out << "room " << room << ": ";
+        printStats(out, m.rooms[room]);
+    }
+    out << "total: ";
+    printStats(out, m.total);
+    if (m.total.hugeBlocks > 0) {
+        const char* policies[] = {"off", "thp", "hugetlb"};
+        out << "huge pages (" << policies[m.pagePolicy] << "): " << m.total.hugeBlocks << " blocks, "
+            << m.total.hugetlbFallbacks << " hugetlb fallbacks, "
+            << readHugePageBytes("/proc/self/smaps_rollup", 0, UINTPTR_MAX) << " B backed by huge pages now" << endl;
+    }
+}
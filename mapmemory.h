@@ -0,0 +1,188 @@
+#ifndef MAPMEMORY_H
+#define MAPMEMORY_H
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <new>
+
+// Tracked allocation for map storage.
+// Every block used by createMap and resizeMap goes through mapAlloc, which keeps
+// current/peak byte counts for the whole game and for each room, and refuses
+// allocations that would exceed the memory budget instead of running out of memory.
+// The budget comes from $DUNGEON_MEMORY_BUDGET (bytes, with an optional K, M or G
+// suffix) or setMapMemoryBudget. Setting $DUNGEON_MEMORY_REPORT prints a report to
+// cerr when each room ends and when the program exits.
+// While a room arena is set, mapAlloc carves blocks out of it and mapFree ignores
+// them; the arena's chunks are the tracked heap blocks. Blocks of at least
+// MAP_MMAP_THRESHOLD bytes never come from the arena: they are mapped straight from
+// the OS, so mapExtend can grow them with mremap instead of copying, and mapFree
+// releases them as usual.
+// Mapped blocks of at least MAP_HUGE_PAGE_BYTES follow the page policy from
+// $DUNGEON_HUGE_PAGES (off, thp or hugetlb; thp by default) or setMapPagePolicy:
+// thp aligns them to huge pages and asks for transparent huge pages with
+// MADV_HUGEPAGE, hugetlb takes them from the reserved huge page pool and falls back
+// to thp when the pool is empty. The report shows how much memory huge pages back.
+
+class Arena;
+
+// bytes in front of every map block, holding its size
+const std::size_t MAP_HEADER_BYTES = 16;
+
+// heap blocks at least this large are mapped from the OS
+const std::size_t MAP_MMAP_THRESHOLD = 1 << 20;
+
+// size of a huge page; mapped blocks at least this large follow the page policy
+const std::size_t MAP_HUGE_PAGE_BYTES = 2 << 20;
+
+// how mapped blocks of at least MAP_HUGE_PAGE_BYTES get their pages
+enum MapPagePolicy {
+    MAP_PAGES_SMALL,    // ordinary pages only
+    MAP_PAGES_THP,      // huge-page aligned, advised with MADV_HUGEPAGE
+    MAP_PAGES_HUGETLB   // reserved huge pages, falling back to MAP_PAGES_THP
+};
+
+// byte and call counts of map storage
+struct MapMemoryStats {
+    std::uint64_t currentBytes = 0;
+    std::uint64_t peakBytes = 0;
+    std::uint64_t allocatedBytes = 0;
+    std::uint64_t allocations = 0;
+    std::uint64_t frees = 0;
+    std::uint64_t refusals = 0;
+    std::uint64_t hugeBlocks = 0;       // blocks mapped under MAP_PAGES_THP or MAP_PAGES_HUGETLB
+    std::uint64_t hugetlbFallbacks = 0; // of those, blocks the huge page pool could not hold
+};
+
+/**
+ * Allocate a tracked block for map storage.
+ * @param   bytes       Size of the block.
+ * @return  the block, or nullptr if it would exceed the budget or memory is exhausted.
+ */
+void* mapAlloc(std::size_t bytes);
+
+/**
+ * Allocate a tracked block from the heap, bypassing the room arena.
+ * @param   bytes       Size of the block.
+ * @return  the block, or nullptr if it would exceed the budget or memory is exhausted.
+ */
+void* mapAllocHeap(std::size_t bytes);
+
+/**
+ * Grow a block without copying its contents, where the block allows it.
+ * Only blocks mapped from the OS can grow; the pages are remapped, possibly to a
+ * new address.
+ * @param   block       Block returned by mapAlloc or mapAllocHeap.
+ * @param   bytes       New size, at least the current one.
+ * @return  the grown block, or nullptr if it cannot grow in place or would exceed the
+ *          budget, in which case the block is unchanged.
+ */
+void* mapExtend(void* block, std::size_t bytes);
+
+/**
+ * Release a block returned by mapAlloc or mapAllocHeap. Null pointers and arena blocks are ignored.
+ * @param   block       Block to release.
+ * @return None
+ */
+void mapFree(void* block);
+
+/**
+ * Check whether more map storage can be allocated without exceeding the budget.
+ * Used before allocating a map block by block; a negative answer counts as a refusal.
+ * @param   bytes       Size of the planned allocations.
+ * @return  true if the budget allows them.
+ */
+bool mapMemoryFits(std::uint64_t bytes);
+
+/**
+ * Set the memory budget for map storage.
+ * @param   bytes       Maximum bytes held at once, 0 for no limit.
+ * @return None
+ */
+void setMapMemoryBudget(std::uint64_t bytes);
+
+/**
+ * Set how large mapped blocks get their pages. Blocks already mapped keep theirs.
+ * @param   policy      Page policy for later blocks.
+ * @return None
+ */
+void setMapPagePolicy(MapPagePolicy policy);
+
+/**
+ * Page policy for large mapped blocks.
+ * @return  the current policy.
+ */
+MapPagePolicy mapPagePolicy();
+
+/**
+ * Bytes of a block that are currently backed by huge pages, read from /proc/self/smaps.
+ * @param   block       Block returned by mapAlloc or mapAllocHeap.
+ * @return  huge page bytes in the block's mapping, 0 if none or unknown.
+ */
+std::uint64_t mapHugePageBytes(const void* block);
+
+/**
+ * Route map allocations to a room arena.
+ * @param   arena       Arena owned by the room loop, or nullptr to use the heap.
+ * @return None
+ */
+void setMapArena(Arena* arena);
+
+/**
+ * Arena that map allocations currently come from.
+ * @return  the arena, or nullptr if allocations use the heap.
+ */
+Arena* mapArena();
+
+/**
+ * Start attributing map storage to a room. Rooms are numbered from 1.
+ * @param   room        Room being entered.
+ * @return None
+ */
+void mapMemoryBeginRoom(int room);
+
+/**
+ * Finish the current room, printing its usage if reporting is enabled.
+ * @return None
+ */
+void mapMemoryEndRoom();
+
+/**
+ * Totals for the whole game so far.
+ * @return  map storage statistics.
+ */
+const MapMemoryStats& mapMemoryStats();
+
+/**
+ * Print the totals and the per-room breakdown.
+ * @param   out         Destination stream.
+ * @return None
+ */
+void mapMemoryReport(std::ostream& out);
+
+// Standard allocator over tracked map memory, for map layouts built on containers.
+// Throws std::bad_alloc when the budget refuses a block.
+template <class T>
+struct MapAllocator {
+    using value_type = T;
+
+    MapAllocator() = default;
+    template <class U>
+    MapAllocator(const MapAllocator<U>&) {}
+
+    T* allocate(std::size_t count) {
+        void* block = mapAlloc(count * sizeof(T));
+        if (block == nullptr) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(block);
+    }
+
+    void deallocate(T* block, std::size_t) { mapFree(block); }
+
+    template <class U>
+    bool operator==(const MapAllocator<U>&) const { return true; }
+    template <class U>
+    bool operator!=(const MapAllocator<U>&) const { return false; }
+};
+
+#endif
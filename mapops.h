@@ -0,0 +1,229 @@
+#ifndef MAPOPS_H
+#define MAPOPS_H
+
+#include "logic.h"
+#include "profile.h"
+
+// Game rules written against any map storage.
+// A map type provides rows(), cols(), get(row, col) and set(row, col, tile). The
+// functions follow doPlayerMove and doMonsterAttack tile for tile, so alternative
+// layouts can be checked and benchmarked against the char** game.
+
+// char** map seen through the map interface
+struct CharMap {
+    char** map;
+    int maxRow;
+    int maxCol;
+
+    int rows() const { return maxRow; }
+    int cols() const { return maxCol; }
+    char get(int row, int col) const { return map[row][col]; }
+    void set(int row, int col, char tile) { map[row][col] = tile; }
+};
+
+// whether a character read from a level file is one of the TILE_* tiles
+inline bool isTile(char tile) {
+    return tile == TILE_OPEN || tile == TILE_PLAYER || tile == TILE_TREASURE || tile == TILE_AMULET ||
+           tile == TILE_MONSTER || tile == TILE_PILLAR || tile == TILE_DOOR || tile == TILE_EXIT;
+}
+
+/**
+ * Move the player onto the given tile if the rules allow it. See doPlayerMove.
+ * @param   map         Dungeon map.
+ * @param   player      Player object to by reference to see current location.
+ * @param   nextRow     Player's next row on the dungeon map (up/down).
+ * @param   nextCol     Player's next column on dungeon map (left/right).
+ * @return  Player's movement status after updating player's position.
+ * @update map contents, player
+ */
+template <class Map>
+int movePlayer(Map& map, Player& player, int nextRow, int nextCol) {
+    if (nextRow < 0 || nextRow >= map.rows() || nextCol < 0 || nextCol >= map.cols()) {
+        return STATUS_STAY;
+    }
+
+    int status = STATUS_MOVE;
+    char tile = map.get(nextRow, nextCol);
+    if (tile == TILE_PILLAR || tile == TILE_MONSTER) {
+        return STATUS_STAY;
+    } else if (tile == TILE_TREASURE) {
+        player.treasure++;
+        status = STATUS_TREASURE;
+    } else if (tile == TILE_AMULET) {
+        status = STATUS_AMULET;
+    } else if (tile == TILE_DOOR) {
+        status = STATUS_LEAVE;
+    } else if (tile == TILE_EXIT) {
+        if (player.treasure < 1) {
+            return STATUS_STAY;
+        }
+        status = STATUS_ESCAPE;
+    }
+
+    map.set(player.row, player.col, TILE_OPEN);
+    map.set(nextRow, nextCol, TILE_PLAYER);
+    player.row = nextRow;
+    player.col = nextCol;
+    return status;
+}
+
+/**
+ * Move a monster at (row, col) one tile to (toRow, toCol), toward the player.
+ * The scans below call it unqualified, so a map type can overload it to follow moves.
+ * @param   map         Dungeon map.
+ * @return None
+ * @update map contents
+ */
+template <class Map>
+inline void stepMonster(Map& map, int row, int col, int toRow, int toCol) {
+    char stay = map.get(toRow, toCol);
+    if (stay == TILE_PLAYER) {
+        stay = TILE_OPEN;
+    }
+    PROFILE_COUNT(COUNTER_MONSTERS_MOVED, 1);
+    map.set(toRow, toCol, TILE_MONSTER);
+    map.set(row, col, stay);
+}
+
+/**
+ * Move the monsters left and right of the player one tile toward the player.
+ * @param   map         Dungeon map.
+ * @param   player      Player object by reference for current location.
+ * @return None
+ * @update map contents
+ */
+template <class Map>
+void monsterScanRow(Map& map, const Player& player) {
+    const int row = player.row;
+    const int col = player.col;
+
+    for (int i = col - 1; i >= 0; --i) {
+        PROFILE_COUNT(COUNTER_TILES_SCANNED, 1);
+        char tile = map.get(row, i);
+        if (tile == TILE_PILLAR) {
+            break;
+        }
+        if (tile == TILE_MONSTER) {
+            stepMonster(map, row, i, row, i + 1);
+        }
+    }
+    for (int i = col + 1; i < map.cols(); ++i) {
+        PROFILE_COUNT(COUNTER_TILES_SCANNED, 1);
+        char tile = map.get(row, i);
+        if (tile == TILE_PILLAR) {
+            break;
+        }
+        if (tile == TILE_MONSTER) {
+            stepMonster(map, row, i, row, i - 1);
+        }
+    }
+}
+
+/**
+ * Move the monsters above and below the player one tile toward the player.
+ * @param   map         Dungeon map.
+ * @param   player      Player object by reference for current location.
+ * @return None
+ * @update map contents
+ */
+template <class Map>
+void monsterScanColumn(Map& map, const Player& player) {
+    const int row = player.row;
+    const int col = player.col;
+
+    for (int i = row - 1; i >= 0; --i) {
+        PROFILE_COUNT(COUNTER_TILES_SCANNED, 1);
+        char tile = map.get(i, col);
+        if (tile == TILE_PILLAR) {
+            break;
+        }
+        if (tile == TILE_MONSTER) {
+            stepMonster(map, i, col, i + 1, col);
+        }
+    }
+    for (int i = row + 1; i < map.rows(); ++i) {
+        PROFILE_COUNT(COUNTER_TILES_SCANNED, 1);
+        char tile = map.get(i, col);
+        if (tile == TILE_PILLAR) {
+            break;
+        }
+        if (tile == TILE_MONSTER) {
+            stepMonster(map, i, col, i - 1, col);
+        }
+    }
+}
+
+/**
+ * Move every monster in the player's line of sight one tile toward the player.
+ * See doMonsterAttack.
+ * @param   map         Dungeon map.
+ * @param   player      Player object by reference for current location.
+ * @return  true if a monster reaches the player, false if not.
+ * @update map contents
+ */
+template <class Map>
+bool monsterAttack(Map& map, const Player& player) {
+    monsterScanRow(map, player);
+    monsterScanColumn(map, player);
+    return map.get(player.row, player.col) == TILE_MONSTER;
+}
+
+/**
+ * monsterAttack for maps that can find the next non-open tile in a line.
+ * Besides the map interface, the map provides nextInRow(row, col, step) and
+ * nextInColumn(col, row, step), returning the nearest non-open tile strictly past
+ * the given one, or -1 / the dimension if there is none. Only those tiles are visited.
+ * @param   map         Dungeon map.
+ * @param   player      Player object by reference for current location.
+ * @return  true if a monster reaches the player, false if not.
+ * @update map contents
+ */
+template <class Map>
+bool monsterAttackSkipping(Map& map, const Player& player) {
+    const int row = player.row;
+    const int col = player.col;
+
+    for (int i = map.nextInRow(row, col, -1); i >= 0; i = map.nextInRow(row, i, -1)) {
+        PROFILE_COUNT(COUNTER_TILES_SCANNED, 1);
+        char tile = map.get(row, i);
+        if (tile == TILE_PILLAR) {
+            break;
+        }
+        if (tile == TILE_MONSTER) {
+            stepMonster(map, row, i, row, i + 1);
+        }
+    }
+    for (int i = map.nextInRow(row, col, 1); i < map.cols(); i = map.nextInRow(row, i, 1)) {
+        PROFILE_COUNT(COUNTER_TILES_SCANNED, 1);
+        char tile = map.get(row, i);
+        if (tile == TILE_PILLAR) {
+            break;
+        }
+        if (tile == TILE_MONSTER) {
+            stepMonster(map, row, i, row, i - 1);
+        }
+    }
+    for (int i = map.nextInColumn(col, row, -1); i >= 0; i = map.nextInColumn(col, i, -1)) {
+        PROFILE_COUNT(COUNTER_TILES_SCANNED, 1);
+        char tile = map.get(i, col);
+        if (tile == TILE_PILLAR) {
+            break;
+        }
+        if (tile == TILE_MONSTER) {
+            stepMonster(map, i, col, i + 1, col);
+        }
+    }
+    for (int i = map.nextInColumn(col, row, 1); i < map.rows(); i = map.nextInColumn(col, i, 1)) {
+        PROFILE_COUNT(COUNTER_TILES_SCANNED, 1);
+        char tile = map.get(i, col);
+        if (tile == TILE_PILLAR) {
+            break;
+        }
+        if (tile == TILE_MONSTER) {
+            stepMonster(map, i, col, i - 1, col);
+        }
+    }
+    return map.get(row, col) == TILE_MONSTER;
+}
+
+#endif
@@ -0,0 +1,231 @@
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include "packedmap.h"
+#include "helper.h"
+#include "mapmemory.h"
+#include "mapops.h"
+#include "profile.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PACKED_SIMD 1
+#endif
+
+namespace {
+
+#ifdef PACKED_SIMD
+/**
+ * Decode 32 tiles from 16 packed bytes with a byte shuffle as the lookup table.
+ * @param   in          16 packed bytes.
+ * @param   out         32 tile characters.
+ * @return None
+ */
+__attribute__((target("ssse3")))
+void unpack32(const std::uint8_t* in, char* out) {
+    const __m128i table = _mm_setr_epi8(PACKED_TILES[0], PACKED_TILES[1], PACKED_TILES[2], PACKED_TILES[3],
+                                        PACKED_TILES[4], PACKED_TILES[5], PACKED_TILES[6], PACKED_TILES[7],
+                                        0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask = _mm_set1_epi8(0x0F);
+    __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+    __m128i low = _mm_and_si128(packed, mask);
+    __m128i high = _mm_and_si128(_mm_srli_epi16(packed, 4), mask);
+    __m128i first = _mm_unpacklo_epi8(low, high);
+    __m128i second = _mm_unpackhi_epi8(low, high);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_shuffle_epi8(table, first));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16), _mm_shuffle_epi8(table, second));
+}
+
+const bool HAS_SSSE3 = __builtin_cpu_supports("ssse3");
+#endif
+
+}
+
+PackedMap::~PackedMap() {
+    clear();
+}
+
+void PackedMap::clear() {
+    mapFree(data);
+    data = nullptr;
+    maxRow = 0;
+    maxCol = 0;
+    stride = 0;
+}
+
+bool PackedMap::create(int rows, int cols) {
+    clear();
+    if (rows <= 0 || cols <= 0) {
+        return false;
+    }
+    int width = (cols + 1) / 2;
+    std::uint64_t total = 1ULL * rows * width;
+    if (!mapMemoryFits(total)) {
+        return false;
+    }
+    data = static_cast<std::uint8_t*>(mapAlloc(total));
+    if (data == nullptr) {
+        return false;
+    }
+    // code 0 is TILE_OPEN
+    std::memset(data, 0, total);
+    maxRow = rows;
+    maxCol = cols;
+    stride = width;
+    return true;
+}
+
+bool PackedMap::load(char** map, int rows, int cols) {
+    if (!create(rows, cols)) {
+        return false;
+    }
+    for (int i = 0; i < rows; ++i) {
+        packRow(i, map[i]);
+    }
+    return true;
+}
+
+void PackedMap::packRow(int row, const char* tiles) {
+    std::uint8_t* out = data + static_cast<std::size_t>(row) * stride;
+    int j = 0;
+    for (; j + 1 < maxCol; j += 2) {
+        out[j / 2] = static_cast<std::uint8_t>(packTile(tiles[j]) | (packTile(tiles[j + 1]) << 4));
+    }
+    if (j < maxCol) {
+        out[j / 2] = packTile(tiles[j]);
+    }
+}
+
+void PackedMap::unpackRow(int row, char* out) const {
+    const std::uint8_t* in = data + static_cast<std::size_t>(row) * stride;
+    int j = 0;
+#ifdef PACKED_SIMD
+    if (HAS_SSSE3) {
+        for (; j + 32 <= maxCol; j += 32) {
+            unpack32(in + j / 2, out + j);
+        }
+    }
+#endif
+    for (; j < maxCol; ++j) {
+        out[j] = PACKED_TILES[(in[j / 2] >> ((j & 1) * 4)) & 0x0F];
+    }
+}
+
+bool PackedMap::resize() {
+    PROFILE_PHASE(PHASE_RESIZE);
+    // a doubled dimension past INT_MAX keeps the current map, as in resizeMap
+    if (maxRow > INT_MAX / 2 || maxCol > INT_MAX / 2) {
+        return false;
+    }
+    PackedMap larger;
+    if (!larger.create(2 * maxRow, 2 * maxCol)) {
+        return false;
+    }
+
+    // the player is copied once, at its old position
+    std::vector<char> line(2 * maxCol);
+    for (int i = 0; i < maxRow; ++i) {
+        unpackRow(i, line.data());
+        char* player = static_cast<char*>(std::memchr(line.data(), TILE_PLAYER, maxCol));
+        if (player != nullptr) {
+            *player = TILE_OPEN;
+        }
+        std::memcpy(line.data() + maxCol, line.data(), maxCol);
+        larger.packRow(i + maxRow, line.data());
+        if (player != nullptr) {
+            *player = TILE_PLAYER;
+        }
+        larger.packRow(i, line.data());
+    }
+
+    std::swap(data, larger.data);
+    std::swap(maxRow, larger.maxRow);
+    std::swap(maxCol, larger.maxCol);
+    std::swap(stride, larger.stride);
+    return true;
+}
+
+bool loadPackedLevel(const std::string& fileName, PackedMap& map, Player& player) {
+    PROFILE_PHASE(PHASE_LOAD);
+    std::ifstream ifs(fileName);
+    if (!ifs.is_open()) {
+        cout << "Error: File unable to open: " << fileName << endl;
+        return false;
+    }
+    int maxRow = 0;
+    int maxCol = 0;
+    ifs >> maxRow >> maxCol;
+    ifs >> player.row >> player.col;
+    if (!ifs || !map.create(maxRow, maxCol) ||
+        player.row < 0 || player.row >= maxRow || player.col < 0 || player.col >= maxCol) {
+        cout << "Error: Map unable to open." << endl;
+        map.create(0, 0);
+        return false;
+    }
+
+    std::vector<char> line(maxCol);
+    for (int i = 0; i < maxRow; ++i) {
+        for (int j = 0; j < maxCol; ++j) {
+            ifs >> line[j];
+            if (!ifs || !isPackedTile(line[j])) {
+                cout << "Error: Map unable to open." << endl;
+                map.create(0, 0);
+                return false;
+            }
+        }
+        if (i == player.row) {
+            line[player.col] = TILE_PLAYER;
+        }
+        map.packRow(i, line.data());
+    }
+    return true;
+}
+
+bool monsterAttack(PackedMap& map, const Player& player) {
+    thread_local std::vector<char> tiles;
+    tiles.resize(map.cols());
+    map.unpackRow(player.row, tiles.data());
+
+    char* line = tiles.data();
+    CharMap row{&line, 1, map.cols()};
+    Player inRow = player;
+    inRow.row = 0;
+    monsterScanRow(row, inRow);
+    map.packRow(player.row, line);
+
+    monsterScanColumn(map, player);
+    return map.get(player.row, player.col) == TILE_MONSTER;
+}
+
+void outputPackedMap(const PackedMap& map) {
+    PROFILE_PHASE(PHASE_RENDER);
+    const int maxRow = map.rows();
+    const int maxCol = map.cols();
+    PROFILE_COUNT(COUNTER_BYTES_RENDERED, (maxRow + 2LL) * (maxCol * 1LL * DISPLAY_WIDTH + 3));
+
+    // one output line: the borders, DISPLAY_WIDTH characters per tile and a newline
+    std::vector<char> tiles(maxCol);
+    std::vector<char> line(maxCol * DISPLAY_WIDTH + 3, '-');
+    line.front() = '+';
+    line[line.size() - 2] = '+';
+    line.back() = '\n';
+    cout.write(line.data(), line.size());
+
+    std::fill(line.begin() + 1, line.end() - 2, ' ');
+    line.front() = '|';
+    line[line.size() - 2] = '|';
+    for (int i = 0; i < maxRow; ++i) {
+        map.unpackRow(i, tiles.data());
+        for (int j = 0; j < maxCol; ++j) {
+            line[1 + j * DISPLAY_WIDTH + 1] = tiles[j] == TILE_OPEN ? ' ' : tiles[j];
+        }
+        cout.write(line.data(), line.size());
+    }
+
+    std::fill(line.begin() + 1, line.end() - 2, '-');
+    line.front() = '+';
+    line[line.size() - 2] = '+';
+    cout.write(line.data(), line.size());
+    cout.flush();
+}
@@ -0,0 +1,147 @@
+#ifndef PACKEDMAP_H
+#define PACKEDMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "logic.h"
+
+// Map that stores two tiles per byte.
+// The eight TILE_* kinds map to 4-bit codes; even columns use the low nibble and odd
+// columns the high nibble. Rows are padded to whole bytes and come from tracked map
+// memory, so a packed map takes half the bytes of the char** map.
+
+// tile character for each nibble code
+const char PACKED_TILES[8] = {TILE_OPEN, TILE_PLAYER, TILE_TREASURE, TILE_AMULET,
+                              TILE_MONSTER, TILE_PILLAR, TILE_DOOR, TILE_EXIT};
+
+/**
+ * Nibble code of a tile character.
+ * @param   tile        One of the TILE_* characters.
+ * @return  code from 0 to 7; unknown characters are stored as TILE_OPEN, so check
+ *          them with isPackedTile first.
+ */
+inline std::uint8_t packTile(char tile) {
+    switch (tile) {
+        case TILE_PLAYER:   return 1;
+        case TILE_TREASURE: return 2;
+        case TILE_AMULET:   return 3;
+        case TILE_MONSTER:  return 4;
+        case TILE_PILLAR:   return 5;
+        case TILE_DOOR:     return 6;
+        case TILE_EXIT:     return 7;
+        default:            return 0;
+    }
+}
+
+// whether a character is one of the eight tiles a packed map can hold
+inline bool isPackedTile(char tile) {
+    return tile == TILE_OPEN || packTile(tile) != 0;
+}
+
+class PackedMap {
+public:
+    PackedMap() = default;
+    ~PackedMap();
+    PackedMap(const PackedMap&) = delete;
+    PackedMap& operator=(const PackedMap&) = delete;
+
+    /**
+     * Allocate an all-TILE_OPEN map, releasing the current one.
+     * @param   maxRow      Number of rows.
+     * @param   maxCol      Number of columns.
+     * @return  true on success, false if the size is invalid or exceeds the memory budget.
+     */
+    bool create(int maxRow, int maxCol);
+
+    /**
+     * Pack a char** map.
+     * @param   map         Dungeon map.
+     * @param   maxRow      Number of rows.
+     * @param   maxCol      Number of columns.
+     * @return  true on success, false if the map cannot be allocated.
+     */
+    bool load(char** map, int maxRow, int maxCol);
+
+    /**
+     * Decode one row into tile characters.
+     * Uses SSSE3 when the CPU has it, 32 tiles per step.
+     * @param   row         Row to decode.
+     * @param   out         Buffer of at least cols() characters.
+     * @return None
+     */
+    void unpackRow(int row, char* out) const;
+
+    /**
+     * Double both dimensions the way resizeMap does.
+     * @return  true on success, false if the larger map exceeds the memory budget or a
+     *          dimension would pass INT_MAX, in which case the map is unchanged.
+     */
+    bool resize();
+
+    /**
+     * Encode tile characters into one row.
+     * @param   row         Row to overwrite.
+     * @param   tiles       cols() tile characters.
+     * @return None
+     */
+    void packRow(int row, const char* tiles);
+
+    // release the storage
+    void clear();
+
+    int rows() const { return maxRow; }
+    int cols() const { return maxCol; }
+
+    char get(int row, int col) const {
+        std::uint8_t byte = data[static_cast<std::size_t>(row) * stride + (col >> 1)];
+        return PACKED_TILES[(byte >> ((col & 1) * 4)) & 0x0F];
+    }
+
+    void set(int row, int col, char tile) {
+        std::uint8_t& byte = data[static_cast<std::size_t>(row) * stride + (col >> 1)];
+        int shift = (col & 1) * 4;
+        byte = static_cast<std::uint8_t>((byte & ~(0x0F << shift)) | (packTile(tile) << shift));
+    }
+
+    // bytes held by the tiles
+    std::uint64_t bytes() const { return 1ULL * maxRow * stride; }
+
+private:
+    std::uint8_t* data = nullptr;
+    int maxRow = 0;
+    int maxCol = 0;
+    int stride = 0;
+};
+
+/**
+ * Load a level file straight into a packed map, without a char** copy.
+ * The file format and player handling match loadLevel.
+ * @param   fileName    File name of dungeon level.
+ * @param   map         Packed map to fill.
+ * @param   player      Player object by reference to set starting position.
+ * @return  true on success, false if the file cannot be read, ends early, holds a
+ *          character that is not a tile, places the player off the map or the map cannot
+ *          be allocated.
+ * @update  map, player
+ */
+bool loadPackedLevel(const std::string& fileName, PackedMap& map, Player& player);
+
+/**
+ * Move every monster in the player's line of sight one tile toward the player.
+ * The player's row is unpacked once so the row scans read plain characters.
+ * @param   map         Packed map.
+ * @param   player      Player object by reference for current location.
+ * @return  true if a monster reaches the player, false if not.
+ * @update map contents
+ */
+bool monsterAttack(PackedMap& map, const Player& player);
+
+/**
+ * Print a packed map exactly as outputMap prints the same char** map.
+ * @param   map         Packed map.
+ * @return None
+ */
+void outputPackedMap(const PackedMap& map);
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+#include <algorithm>
+#include <cstddef>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+// Splitting bulk map work across threads.
+// Work under PARALLEL_MAP_BYTES runs on the calling thread, so small rooms never
+// start a thread; larger work is cut into one contiguous slice per thread. Results
+// never depend on how many threads ran, so setMapThreads only changes the speed.
+
+// map work is split across threads from this many bytes on
+const std::size_t PARALLEL_MAP_BYTES = 64 << 20;
+
+// most threads map work is split across
+const unsigned MAX_MAP_THREADS = 8;
+
+// threads map work may use, 0 for one per core; see setMapThreads
+inline unsigned mapThreadLimit = 0;
+
+/**
+ * Set how many threads map work may use, for instance to measure scaling.
+ * @param   threads     Most threads, capped at MAX_MAP_THREADS; 0 for one per core.
+ * @return None
+ */
+inline void setMapThreads(unsigned threads) {
+    mapThreadLimit = threads;
+}
+
+/**
+ * Run body over [0, count) in slices on up to MAX_MAP_THREADS threads, or on the
+ * calling thread when the work is under PARALLEL_MAP_BYTES. Slices do not overlap and
+ * all have finished when parallelFor returns.
+ * @param   count       Number of items.
+ * @param   bytesPerItem  Bytes each item touches.
+ * @param   body        Called as body(first, last) for each slice.
+ * @return None
+ */
+template <class Body>
+void parallelFor(std::size_t count, std::size_t bytesPerItem, const Body& body) {
+    std::size_t threads = 1;
+    if (count * bytesPerItem >= PARALLEL_MAP_BYTES) {
+        unsigned cores = mapThreadLimit != 0 ? mapThreadLimit : std::max(1u, std::thread::hardware_concurrency());
+        threads = std::min<std::size_t>({cores, MAX_MAP_THREADS, count});
+    }
+    std::vector<std::thread> workers;
+    std::size_t first = 0;
+    for (std::size_t t = 0; t < threads; t++) {
+        std::size_t last = count * (t + 1) / threads;
+        if (t + 1 < threads) {
+            try {
+                workers.emplace_back(body, first, last);
+            } catch (const std::system_error&) {
+                // no thread to spare, run this slice here
+                body(first, last);
+            }
+        } else {
+            body(first, last);
+        }
+        first = last;
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+#endif
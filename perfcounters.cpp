@@ -0,0 +1,190 @@
+#include "perfcounters.h"
+
+#ifdef DUNGEON_PERF
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include "profile.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using std::endl;
+
+namespace {
+
+struct CounterSpec {
+    const char* name;
+    std::uint32_t type;
+    std::uint64_t config;
+};
+
+#ifdef __linux__
+const std::uint64_t L1D_READ_ACCESS = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                      (PERF_COUNT_HW_CACHE_RESULT_ACCESS << 16);
+const std::uint64_t L1D_READ_MISS = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+const std::uint64_t DTLB_READ_MISS = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                     (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+
+const CounterSpec COUNTERS[PERF_COUNTER_COUNT] = {
+    {"cycles",        PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions",  PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"branches",      PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS},
+    {"branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {"L1d-loads",     PERF_TYPE_HW_CACHE, L1D_READ_ACCESS},
+    {"L1d-misses",    PERF_TYPE_HW_CACHE, L1D_READ_MISS},
+    {"LLC-misses",    PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {"dTLB-misses",   PERF_TYPE_HW_CACHE, DTLB_READ_MISS},
+    {"task-clock",    PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+    {"page-faults",   PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+};
+#endif
+
+// totals for one phase
+struct PerfPhase {
+    std::uint64_t calls = 0;
+    std::uint64_t totals[PERF_COUNTER_COUNT] = {};
+};
+
+struct PerfState {
+    int fds[PERF_COUNTER_COUNT];
+    int openErrors[PERF_COUNTER_COUNT];
+    PerfPhase phases[PHASE_COUNT];
+
+    PerfState() {
+        for (int i = 0; i < PERF_COUNTER_COUNT; ++i) {
+            fds[i] = -1;
+            openErrors[i] = ENOSYS;
+#ifdef __linux__
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = COUNTERS[i].type;
+            attr.config = COUNTERS[i].config;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            fds[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+            openErrors[i] = fds[i] < 0 ? errno : 0;
+#endif
+        }
+    }
+
+    // the report is printed when the program exits, whichever way main returns
+    ~PerfState() {
+        report(std::cerr);
+#ifdef __linux__
+        for (int fd : fds) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+#endif
+    }
+
+    bool available(int counter) const {
+        return fds[counter] >= 0;
+    }
+
+    // events per thousand of another event, or -1 if either counter is missing
+    double ratio(const PerfPhase& phase, int numerator, int denominator, double scale) const {
+        if (!available(numerator) || !available(denominator) || phase.totals[denominator] == 0) {
+            return -1.0;
+        }
+        return scale * phase.totals[numerator] / phase.totals[denominator];
+    }
+
+    void printRatio(std::ostream& out, double value, int width) const {
+        out.width(width);
+        if (value < 0.0) {
+            out << "n/a";
+        } else {
+            out << value;
+        }
+    }
+
+    void report(std::ostream& out) const {
+        out << endl << "=== hardware counters per phase ===" << endl;
+        for (int i = 0; i < PERF_COUNTER_COUNT; ++i) {
+            if (!available(i)) {
+#ifdef __linux__
+                out << "  " << COUNTERS[i].name << " unavailable: " << std::strerror(openErrors[i]) << endl;
+#endif
+            }
+        }
+        out.setf(std::ios::fixed);
+        out.precision(2);
+        out << "  phase                 calls     task ms      IPC  L1d miss %  LLC miss/kinstr  dTLB miss/kinstr"
+               "  branch miss %  page faults" << endl;
+        for (int p = 0; p < PHASE_COUNT; ++p) {
+            const PerfPhase& phase = phases[p];
+            if (phase.calls == 0) {
+                continue;
+            }
+            out << "  ";
+            out.width(16);
+            out << std::left << phaseName(static_cast<Phase>(p)) << std::right;
+            out.width(11);
+            out << phase.calls;
+            printRatio(out, available(PERF_TASK_CLOCK) ? phase.totals[PERF_TASK_CLOCK] / 1e6 : -1.0, 12);
+            printRatio(out, ratio(phase, PERF_INSTRUCTIONS, PERF_CYCLES, 1.0), 9);
+            printRatio(out, ratio(phase, PERF_L1D_MISSES, PERF_L1D_LOADS, 100.0), 12);
+            printRatio(out, ratio(phase, PERF_LLC_MISSES, PERF_INSTRUCTIONS, 1000.0), 17);
+            printRatio(out, ratio(phase, PERF_DTLB_MISSES, PERF_INSTRUCTIONS, 1000.0), 18);
+            printRatio(out, ratio(phase, PERF_BRANCH_MISSES, PERF_BRANCHES, 100.0), 15);
+            out.width(13);
+            if (available(PERF_PAGE_FAULTS)) {
+                out << phase.totals[PERF_PAGE_FAULTS] << endl;
+            } else {
+                out << "n/a" << endl;
+            }
+        }
+        out.unsetf(std::ios::fixed);
+    }
+};
+
+PerfState& perf() {
+    static PerfState instance;
+    return instance;
+}
+
+}
+
+void perfRead(PerfSample& sample) {
+    PerfState& state = perf();
+    for (int i = 0; i < PERF_COUNTER_COUNT; ++i) {
+        sample.values[i] = 0;
+#ifdef __linux__
+        std::uint64_t data[3];
+        if (state.fds[i] >= 0 && read(state.fds[i], data, sizeof(data)) == sizeof(data) && data[2] > 0) {
+            // scale up when the kernel multiplexed the counter onto the hardware
+            sample.values[i] = data[2] < data[1] ? static_cast<std::uint64_t>(1.0 * data[0] * data[1] / data[2])
+                                                 : data[0];
+        }
+#endif
+    }
+}
+
+bool perfAvailable(int counter) {
+    return perf().available(counter);
+}
+
+void perfPhaseEnd(int phase, const PerfSample& start) {
+    PerfSample end;
+    perfRead(end);
+    PerfPhase& totals = perf().phases[phase];
+    totals.calls++;
+    for (int i = 0; i < PERF_COUNTER_COUNT; ++i) {
+        if (end.values[i] > start.values[i]) {
+            totals.totals[i] += end.values[i] - start.values[i];
+        }
+    }
+}
+
+#endif
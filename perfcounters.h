@@ -0,0 +1,58 @@
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+#include <cstdint>
+
+// Hardware performance counters per game phase, read through Linux perf_event_open.
+// Compile with -DDUNGEON_PERF and link perfcounters.cpp to enable it; PROFILE_PHASE
+// scopes then also read the counters on entry and exit. Counters the kernel or
+// container refuses to open are reported as unavailable and left out, so the game
+// still runs where perf_event_open is blocked. Only the main thread is counted.
+
+// counters opened for the calling thread
+enum PerfCounter {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_BRANCHES,
+    PERF_BRANCH_MISSES,
+    PERF_L1D_LOADS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_DTLB_MISSES,
+    PERF_TASK_CLOCK,
+    PERF_PAGE_FAULTS,
+    PERF_COUNTER_COUNT
+};
+
+// counter values at one point in time, scaled for multiplexing
+struct PerfSample {
+    std::uint64_t values[PERF_COUNTER_COUNT];
+};
+
+#ifdef DUNGEON_PERF
+
+/**
+ * Read every open counter. Opens the counters on first use.
+ * @param   sample      Current counter values, 0 for unavailable counters.
+ * @return None
+ * @update sample
+ */
+void perfRead(PerfSample& sample);
+
+/**
+ * Check whether a counter could be opened.
+ * @param   counter     Counter index (a PerfCounter).
+ * @return  true if perfRead reports real values for it.
+ */
+bool perfAvailable(int counter);
+
+/**
+ * Read the counters again and add the difference to a phase's totals.
+ * @param   phase       Phase index (a Phase from profile.h).
+ * @param   start       Sample taken when the phase began.
+ * @return None
+ */
+void perfPhaseEnd(int phase, const PerfSample& start);
+
+#endif
+
+#endif
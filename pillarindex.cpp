@@ -0,0 +1,302 @@
+#include <algorithm>
+#include <cstdint>
+#include "pillarindex.h"
+#include "parallel.h"
+#include "profile.h"
+
+namespace {
+
+// lines indexed together, so both directions read the map a row at a time
+const int LINE_BLOCK = 64;
+
+// tiles of a line, addressed by position along the line
+struct RowLine {
+    char** map;
+    int row;
+    char& operator()(int col) const { return map[row][col]; }
+};
+
+struct ColumnLine {
+    char** map;
+    int col;
+    char& operator()(int row) const { return map[row][col]; }
+};
+
+/**
+ * Count the segments of lines [first, last) of one direction.
+ * @param   tile        tile(line, position) reads a tile.
+ * @param   length      Tiles per line.
+ * @param   counts      counts[line + 1] receives the segment count of each line.
+ * @return None
+ * @update counts
+ */
+template <class Tile>
+void countSegments(const Tile& tile, int first, int last, int length, std::uint64_t* counts) {
+    std::uint64_t found[LINE_BLOCK] = {};
+    bool pillar[LINE_BLOCK];
+    for (int line = first; line < last; ++line) {
+        pillar[line - first] = true;
+    }
+    for (int pos = 0; pos < length; ++pos) {
+        for (int line = first; line < last; ++line) {
+            bool here = tile(line, pos) == TILE_PILLAR;
+            found[line - first] += pillar[line - first] && !here;
+            pillar[line - first] = here;
+        }
+    }
+    for (int line = first; line < last; ++line) {
+        counts[line + 1] = found[line - first];
+    }
+}
+
+/**
+ * Label every tile of lines [first, last) of one direction with its segment, and
+ * record each segment's bounds and monsters. A segment is only touched when it opens,
+ * when a monster is on it and when it closes.
+ * @param   tile        tile(line, position) reads a tile.
+ * @param   lines       Number of lines in this direction.
+ * @param   length      Tiles per line.
+ * @param   offsets     Index of each line's first segment.
+ * @param   segments    Segments of all lines.
+ * @param   ids         ids[position * lines + line] receives the segment ID of a tile.
+ * @return None
+ * @update segments, ids
+ */
+template <class Tile>
+void labelSegments(const Tile& tile, int first, int last, int lines, int length, const std::uint64_t* offsets,
+                   PillarSegment* segments, std::uint32_t* ids) {
+    std::uint32_t next[LINE_BLOCK];
+    bool open[LINE_BLOCK] = {};
+    for (int line = first; line < last; ++line) {
+        next[line - first] = NO_SEGMENT;
+    }
+    for (int pos = 0; pos < length; ++pos) {
+        std::uint32_t* out = ids + static_cast<std::size_t>(pos) * lines;
+        for (int line = first; line < last; ++line) {
+            int k = line - first;
+            char current = tile(line, pos);
+            if (current == TILE_PILLAR) {
+                if (open[k]) {
+                    segments[offsets[line] + next[k]].last = pos - 1;
+                    open[k] = false;
+                }
+                out[line] = NO_SEGMENT;
+                continue;
+            }
+            if (!open[k]) {
+                segments[offsets[line] + ++next[k]] = PillarSegment{pos, pos, 0};
+                open[k] = true;
+            }
+            out[line] = next[k];
+            if (current == TILE_MONSTER) {
+                segments[offsets[line] + next[k]].monsters++;
+            }
+        }
+    }
+    for (int line = first; line < last; ++line) {
+        if (open[line - first]) {
+            segments[offsets[line] + next[line - first]].last = length - 1;
+        }
+    }
+}
+
+/**
+ * Move the monsters on the player's segment of one line one tile toward the player,
+ * nearest first on each side. Stepping out from the player on both sides at once
+ * gives the same result as finishing one side before the other: a monster only
+ * swaps with the tile next to it on the player's side, which has already moved.
+ * @param   line        Tiles of the line.
+ * @param   player      Player's position on the line.
+ * @param   run         Player's segment of the line.
+ * @param   moved       Called with (position, step) for every monster that leaves
+ *                      position, unless it swapped places with another monster.
+ * @return None
+ */
+template <class Line, class Moved>
+void chargeAlongLine(const Line& line, int player, const PillarSegment& run, const Moved& moved) {
+    std::uint32_t seen = line(player) == TILE_MONSTER ? 1 : 0;
+    for (int distance = 1; seen < run.monsters; ++distance) {
+        int before = player - distance;
+        int after = player + distance;
+        if (before < run.first && after > run.last) {
+            break;
+        }
+        for (int step : {1, -1}) {
+            int i = step == 1 ? before : after;
+            if (i < run.first || i > run.last) {
+                continue;
+            }
+            PROFILE_COUNT(COUNTER_TILES_SCANNED, 1);
+            if (line(i) != TILE_MONSTER) {
+                continue;
+            }
+            seen++;
+            char stay = line(i + step);
+            if (stay == TILE_PLAYER) {
+                stay = TILE_OPEN;
+            }
+            PROFILE_COUNT(COUNTER_MONSTERS_MOVED, 1);
+            line(i + step) = line(i);
+            line(i) = stay;
+            if (stay != TILE_MONSTER) {
+                moved(i, step);
+            }
+        }
+    }
+}
+
+}
+
+PillarIndex::~PillarIndex() {
+    release();
+}
+
+bool PillarIndex::build(char** map, int rows, int cols) {
+    PROFILE_PHASE(PHASE_INDEX);
+    release();
+    if (rows <= 0 || cols <= 0) {
+        return false;
+    }
+    std::size_t tiles = static_cast<std::size_t>(rows) * cols;
+    std::size_t offsetBytes = sizeof(std::uint64_t) * (2ULL + rows + cols);
+    if (tiles > (SIZE_MAX - offsetBytes) / (2 * sizeof(std::uint32_t))) {
+        return false;
+    }
+    char* block = static_cast<char*>(mapAlloc(offsetBytes + 2 * sizeof(std::uint32_t) * tiles));
+    if (block == nullptr) {
+        return false;
+    }
+    maxRow = rows;
+    maxCol = cols;
+    rowFirst = reinterpret_cast<std::uint64_t*>(block);
+    columnFirst = rowFirst + rows + 1;
+    rowIds = reinterpret_cast<std::uint32_t*>(block + offsetBytes);
+    columnIds = rowIds + tiles;
+
+    // rows and columns are both walked LINE_BLOCK lines at a time, position by position
+    auto byRow = [map](int row, int col) { return map[row][col]; };
+    auto byColumn = [map](int col, int row) { return map[row][col]; };
+    std::size_t rowBlocks = (rows + LINE_BLOCK - 1) / LINE_BLOCK;
+    std::size_t columnBlocks = (cols + LINE_BLOCK - 1) / LINE_BLOCK;
+    auto eachBlock = [](std::size_t blocks, int lines, int length, const auto& body) {
+        parallelFor(blocks, 1ULL * LINE_BLOCK * length, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t b = begin; b < end; ++b) {
+                int first = static_cast<int>(b) * LINE_BLOCK;
+                body(first, std::min(lines, first + LINE_BLOCK));
+            }
+        });
+    };
+
+    // count the segments of every row and column, then turn the counts into offsets
+    eachBlock(rowBlocks, rows, cols, [&](int first, int last) {
+        countSegments(byRow, first, last, cols, rowFirst);
+    });
+    eachBlock(columnBlocks, cols, rows, [&](int first, int last) {
+        countSegments(byColumn, first, last, rows, columnFirst);
+    });
+    rowFirst[0] = 0;
+    for (int i = 0; i < rows; ++i) {
+        rowFirst[i + 1] += rowFirst[i];
+    }
+    columnFirst[0] = rowFirst[rows];
+    for (int j = 0; j < cols; ++j) {
+        columnFirst[j + 1] += columnFirst[j];
+    }
+
+    segments = static_cast<PillarSegment*>(mapAlloc(sizeof(PillarSegment) * columnFirst[cols]));
+    if (segments == nullptr) {
+        release();
+        return false;
+    }
+
+    // label every tile with its segment and record the segment bounds and monsters
+    eachBlock(rowBlocks, rows, cols, [&](int first, int last) {
+        labelSegments(byRow, first, last, rows, cols, rowFirst, segments, rowIds);
+    });
+    eachBlock(columnBlocks, cols, rows, [&](int first, int last) {
+        labelSegments(byColumn, first, last, cols, rows, columnFirst, segments, columnIds);
+    });
+    return true;
+}
+
+void PillarIndex::release() {
+    // the offsets and both ID arrays share the first block
+    mapFree(rowFirst);
+    mapFree(segments);
+    rowFirst = nullptr;
+    columnFirst = nullptr;
+    rowIds = nullptr;
+    columnIds = nullptr;
+    segments = nullptr;
+    maxRow = 0;
+    maxCol = 0;
+}
+
+std::uint64_t PillarIndex::bytes() const {
+    if (!built()) {
+        return 0;
+    }
+    std::uint64_t tiles = 1ULL * maxRow * maxCol;
+    return sizeof(std::uint64_t) * (2ULL + maxRow + maxCol) + 2 * sizeof(std::uint32_t) * tiles
+         + sizeof(PillarSegment) * segmentCount();
+}
+
+namespace {
+
+/**
+ * Charge the monsters in the player's segments, as doMonsterAttack does with an index.
+ * @param   moved       Called with (row, col, toRow, toCol) for every monster that
+ *                      swaps places with something other than a monster.
+ * @return  true if a monster reaches the player, false if not.
+ */
+template <class Moved>
+bool attackAlongSegments(char** map, const Player& player, PillarIndex& pillars, const Moved& moved) {
+    int row = player.row;
+    int col = player.col;
+
+    // along the row, a moving monster changes column segments
+    chargeAlongLine(RowLine{map, row}, col, pillars.rowSegment(row, col), [&](int j, int step) {
+        pillars.columnSegment(row, j).monsters--;
+        pillars.columnSegment(row, j + step).monsters++;
+        moved(row, j, row, j + step);
+    });
+    // along the column, a moving monster changes row segments
+    chargeAlongLine(ColumnLine{map, col}, row, pillars.columnSegment(row, col), [&](int i, int step) {
+        pillars.rowSegment(i, col).monsters--;
+        pillars.rowSegment(i + step, col).monsters++;
+        moved(i, col, i + step, col);
+    });
+
+    return map[row][col] == TILE_MONSTER;
+}
+
+}
+
+bool doMonsterAttack(char** map, int maxRow, int maxCol, const Player& player, PillarIndex& pillars) {
+    PROFILE_PHASE(PHASE_MONSTER);
+    (void)maxRow;
+    (void)maxCol;
+    return attackAlongSegments(map, player, pillars, [](int, int, int, int) {});
+}
+
+bool doMonsterAttack(char** map, int maxRow, int maxCol, const Player& player, PillarIndex& pillars,
+                     EntityStore& entities) {
+    PROFILE_PHASE(PHASE_MONSTER);
+    (void)maxRow;
+    (void)maxCol;
+    entities.beginTurn();
+    if (entities.quiet(player)) {
+        return false;
+    }
+    bool moved = false;
+    bool caught = attackAlongSegments(map, player, pillars, [&](int row, int col, int toRow, int toCol) {
+        entities.step(row, col, toRow, toCol);
+        moved = true;
+    });
+
+    // the same segments would give the same charges next turn
+    if (!moved && !caught) {
+        entities.markQuiet(player);
+    }
+    return caught;
+}
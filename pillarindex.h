@@ -0,0 +1,161 @@
+#ifndef PILLARINDEX_H
+#define PILLARINDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include "entities.h"
+#include "logic.h"
+#include "mapmemory.h"
+
+// Segments of a char** map's rows and columns, split at its pillars.
+// Pillars never move, so every maximal pillar-free run of a row or column keeps its
+// bounds for the whole room: two tiles of a line see each other exactly when they
+// share a segment ID, and a segment's bounds are one array lookup. Each segment also
+// counts the monsters on it, which lets doMonsterAttack stop once it has passed them
+// all instead of walking to the nearest pillar. Build the index after loadLevel and
+// again after every resizeMap. Storage comes from tracked map memory, in two blocks.
+// Row segment IDs are stored column by column and column segment IDs row by row, so
+// the counts a monster updates as it steps along either line sit next to each other.
+
+// segment ID of pillar tiles
+const std::uint32_t NO_SEGMENT = ~std::uint32_t(0);
+
+// one maximal pillar-free run of a row or column
+struct PillarSegment {
+    int first;              // first column (row) of the run
+    int last;               // last column (row) of the run
+    std::uint32_t monsters; // monsters on the run
+};
+
+/**
+ * Map memory an index of a map with up to the given number of tiles can take,
+ * counting the block headers and arena alignment. A single column is the worst case:
+ * one offset per row, and segments that alternate with pillars down the column.
+ * @param   tiles       Number of tiles.
+ * @return  bytes of both blocks.
+ */
+constexpr std::size_t pillarIndexBytes(std::size_t tiles) {
+    return (MAP_HEADER_BYTES + 16 * tiles + 24 + 15) / 16 * 16
+         + (MAP_HEADER_BYTES + 18 * tiles + 6 + 15) / 16 * 16;
+}
+
+class PillarIndex {
+public:
+    PillarIndex() = default;
+    ~PillarIndex();
+    PillarIndex(const PillarIndex&) = delete;
+    PillarIndex& operator=(const PillarIndex&) = delete;
+
+    /**
+     * Index the pillars and count the monsters of a map, releasing the current index.
+     * Rows and columns are indexed in parallel on large maps; both passes are linear.
+     * @param   map         Dungeon map.
+     * @param   maxRow      Number of rows.
+     * @param   maxCol      Number of columns.
+     * @return  true on success, false if the size is invalid or exceeds the memory budget.
+     */
+    bool build(char** map, int maxRow, int maxCol);
+
+    /**
+     * Account for a tile changed outside doMonsterAttack, keeping the monster counts
+     * right. Pillars must not be placed or removed; rebuild the index for that.
+     * @param   row         Row of the tile.
+     * @param   col         Column of the tile.
+     * @param   before      Tile before the change.
+     * @param   after       Tile after the change.
+     * @return None
+     */
+    void retile(int row, int col, char before, char after) {
+        int delta = (after == TILE_MONSTER) - (before == TILE_MONSTER);
+        if (delta != 0) {
+            rowSegment(row, col).monsters += delta;
+            columnSegment(row, col).monsters += delta;
+        }
+    }
+
+    /**
+     * Free the index. Call it before the room arena the index came from is reset.
+     * @return None
+     */
+    void release();
+
+    // whether build succeeded and the index has not been released since
+    bool built() const { return segments != nullptr; }
+
+    // ID of the row segment holding a tile, counted from 0 in each row; NO_SEGMENT on pillars
+    std::uint32_t rowSegmentId(int row, int col) const {
+        return rowIds[static_cast<std::size_t>(col) * maxRow + row];
+    }
+
+    // ID of the column segment holding a tile, counted from 0 in each column; NO_SEGMENT on pillars
+    std::uint32_t columnSegmentId(int row, int col) const {
+        return columnIds[static_cast<std::size_t>(row) * maxCol + col];
+    }
+
+    // whether no pillar lies on or between two tiles of a row
+    bool rowSight(int row, int colA, int colB) const {
+        std::uint32_t id = rowSegmentId(row, colA);
+        return id != NO_SEGMENT && id == rowSegmentId(row, colB);
+    }
+
+    // whether no pillar lies on or between two tiles of a column
+    bool columnSight(int col, int rowA, int rowB) const {
+        std::uint32_t id = columnSegmentId(rowA, col);
+        return id != NO_SEGMENT && id == columnSegmentId(rowB, col);
+    }
+
+    // row segment holding a tile that is not a pillar
+    PillarSegment& rowSegment(int row, int col) { return segments[rowFirst[row] + rowSegmentId(row, col)]; }
+
+    // column segment holding a tile that is not a pillar
+    PillarSegment& columnSegment(int row, int col) {
+        return segments[columnFirst[col] + columnSegmentId(row, col)];
+    }
+
+    // number of row and column segments
+    std::uint64_t segmentCount() const { return built() ? columnFirst[maxCol] : 0; }
+
+    // bytes held by the index
+    std::uint64_t bytes() const;
+
+private:
+    std::uint64_t* rowFirst = nullptr;    // maxRow + 1 offsets of each row's segments
+    std::uint64_t* columnFirst = nullptr; // maxCol + 1 offsets, after all row segments
+    std::uint32_t* rowIds = nullptr;      // column-major
+    std::uint32_t* columnIds = nullptr;   // row-major
+    PillarSegment* segments = nullptr;
+    int maxRow = 0;
+    int maxCol = 0;
+};
+
+/**
+ * Update monster locations exactly as doMonsterAttack in logic.h does, using the pillar
+ * index for the player's segments: a line with no monsters costs nothing, and each
+ * scan ends at the farthest monster in sight rather than at the nearest pillar.
+ * The index's monster counts follow the moves.
+ * @param   map         Dungeon map the index was built for.
+ * @param   maxRow      Number of rows in the dungeon table (aka height).
+ * @param   maxCol      Number of columns in the dungeon table (aka width).
+ * @param   player      Player object by reference for current location.
+ * @param   pillars     Index of the map.
+ * @return  true if a monster reaches the player, false if not.
+ * @update map contents, pillars
+ */
+bool doMonsterAttack(char** map, int maxRow, int maxCol, const Player& player, PillarIndex& pillars);
+
+/**
+ * Update monster locations as the overload above does, following every move in the
+ * entity store as well. A turn the store knows to be quiet costs nothing.
+ * @param   map         Dungeon map the index and the store were built for.
+ * @param   maxRow      Number of rows in the dungeon table (aka height).
+ * @param   maxCol      Number of columns in the dungeon table (aka width).
+ * @param   player      Player object by reference for current location.
+ * @param   pillars     Index of the map.
+ * @param   entities    Store of the map.
+ * @return  true if a monster reaches the player, false if not.
+ * @update map contents, pillars, entities
+ */
+bool doMonsterAttack(char** map, int maxRow, int maxCol, const Player& player, PillarIndex& pillars,
+                     EntityStore& entities);
+
+#endif
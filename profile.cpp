@@ -0,0 +1,101 @@
+#include <iostream>
+#include <deque>
+#include "profile.h"
+
+#ifdef DUNGEON_PROFILE
+
+using std::endl;
+
+PhaseStats* profileCurrent = nullptr;
+
+namespace {
+
+// phase tables of one room
+struct RoomStats {
+    PhaseStats phases[PHASE_COUNT];
+};
+
+struct Profile {
+    // index 0 collects anything recorded before the first room;
+    // a deque keeps profileCurrent valid while rooms are added
+    std::deque<RoomStats> rooms = std::deque<RoomStats>(1);
+    int room = 0;
+    TickCalibration calibration;
+
+    // the report is printed when the program exits, whichever way main returns
+    ~Profile() { profileDump(std::cerr); }
+};
+
+Profile& profile() {
+    static Profile instance;
+    return instance;
+}
+
+void printTable(std::ostream& out, const PhaseStats* phases, double rate) {
+    out << "  phase                 calls        ticks      mean ns    tiles scanned  monsters moved  bytes rendered" << endl;
+    for (int i = 0; i < PHASE_COUNT; ++i) {
+        const PhaseStats& stats = phases[i];
+        if (stats.calls == 0) {
+            continue;
+        }
+        out << "  ";
+        out.width(16);
+        out << std::left << phaseName(static_cast<Phase>(i)) << std::right;
+        out.width(11);
+        out << stats.calls;
+        out.width(13);
+        out << stats.ticks;
+        out.width(13);
+        out << static_cast<std::uint64_t>(stats.ticks / rate / stats.calls);
+        out.width(17);
+        out << stats.counters[COUNTER_TILES_SCANNED];
+        out.width(16);
+        out << stats.counters[COUNTER_MONSTERS_MOVED];
+        out.width(16);
+        out << stats.counters[COUNTER_BYTES_RENDERED] << endl;
+    }
+}
+
+}
+
+void profileBeginRoom(int room) {
+    Profile& p = profile();
+    if (room >= static_cast<int>(p.rooms.size())) {
+        p.rooms.resize(room + 1);
+    }
+    p.room = room;
+}
+
+PhaseStats* profileEnter(Phase phase) {
+    PhaseStats* previous = profileCurrent;
+    profileCurrent = &profile().rooms[profile().room].phases[phase];
+    return previous;
+}
+
+void profileDump(std::ostream& out) {
+    Profile& p = profile();
+    double rate = p.calibration.rate();
+    RoomStats total;
+
+    out << endl << "=== phase profile (" << rate << " ticks/ns) ===" << endl;
+    for (size_t room = 0; room < p.rooms.size(); ++room) {
+        bool used = false;
+        for (int i = 0; i < PHASE_COUNT; ++i) {
+            const PhaseStats& stats = p.rooms[room].phases[i];
+            used = used || stats.calls > 0;
+            total.phases[i].calls += stats.calls;
+            total.phases[i].ticks += stats.ticks;
+            for (int c = 0; c < COUNTER_COUNT; ++c) {
+                total.phases[i].counters[c] += stats.counters[c];
+            }
+        }
+        if (used) {
+            out << "room " << room << endl;
+            printTable(out, p.rooms[room].phases, rate);
+        }
+    }
+    out << "total" << endl;
+    printTable(out, total.phases, rate);
+}
+
+#endif
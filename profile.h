@@ -0,0 +1,159 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+#include <cstdint>
+#include <iostream>
+#include "ticks.h"
+#include "trace.h"
+#include "perfcounters.h"
+
+// Per-phase instrumentation of the game loop.
+// Compile with -DDUNGEON_PROFILE and link profile.cpp for per-room counter tables,
+// printed to cerr when the program exits, with -DDUNGEON_TRACE and trace.cpp for a
+// timeline of every phase, and with -DDUNGEON_PERF and perfcounters.cpp for hardware
+// counters per phase. Without any of these flags every PROFILE_* macro expands to
+// nothing and the instrumented code is identical to an uninstrumented build.
+
+// phases of a turn, plus level loading
+enum Phase {
+    PHASE_LOAD,         // loadLevel
+    PHASE_INPUT,        // reading the user's command
+    PHASE_TURN,         // one accepted command, from the move to the status output
+    PHASE_MOVE,         // doPlayerMove
+    PHASE_MONSTER,      // doMonsterAttack
+    PHASE_RESIZE,       // resizeMap
+    PHASE_RENDER,       // outputMap
+    PHASE_INDEX,        // PillarIndex::build and EntityStore::build
+    PHASE_FLOW,         // FlowField::build and FlowField::update
+    PHASE_COUNT
+};
+
+// work counters attributed to the phase that is running
+enum Counter {
+    COUNTER_TILES_SCANNED,
+    COUNTER_MONSTERS_MOVED,
+    COUNTER_BYTES_RENDERED,
+    COUNTER_COUNT
+};
+
+/**
+ * Printable phase name, also used as the trace span name.
+ * @param   phase       Phase to name.
+ * @return  string literal naming the phase.
+ */
+inline const char* phaseName(Phase phase) {
+    static const char* const names[PHASE_COUNT] = {
+        "loadLevel", "input", "turn", "doPlayerMove", "doMonsterAttack", "resizeMap", "outputMap",
+        "pillarIndex", "flowField"
+    };
+    return phase < PHASE_COUNT ? names[phase] : "?";
+}
+
+#ifdef DUNGEON_PROFILE
+
+// totals for one phase in one room
+struct PhaseStats {
+    std::uint64_t calls = 0;
+    std::uint64_t ticks = 0;
+    std::uint64_t counters[COUNTER_COUNT] = {};
+};
+
+/**
+ * Start attributing measurements to a room. Rooms are numbered from 1.
+ * @param   room        Current room number.
+ * @return None
+ */
+void profileBeginRoom(int room);
+
+// stats of the running phase in the current room, or nullptr outside any phase
+extern PhaseStats* profileCurrent;
+
+/**
+ * Make a phase current and return the stats slot it replaced.
+ * @param   phase       Phase being entered.
+ * @return  previously current stats slot.
+ */
+PhaseStats* profileEnter(Phase phase);
+
+/**
+ * Add to a work counter of the current phase.
+ * @param   counter     Counter to increase.
+ * @param   amount      Amount to add.
+ * @return None
+ */
+inline void profileCount(Counter counter, std::uint64_t amount) {
+    if (profileCurrent != nullptr) {
+        profileCurrent->counters[counter] += amount;
+    }
+}
+
+/**
+ * Print the per-room and total tables. Also runs automatically at program exit.
+ * @param   out         Destination stream.
+ * @return None
+ */
+void profileDump(std::ostream& out);
+
+#define PROFILE_COUNT(counter, amount) profileCount(counter, amount)
+#define PROFILE_ROOM(room) profileBeginRoom(room)
+
+#else
+
+#define PROFILE_COUNT(counter, amount)
+#define PROFILE_ROOM(room)
+
+#endif
+
+#if defined(DUNGEON_PROFILE) || defined(DUNGEON_TRACE) || defined(DUNGEON_PERF)
+
+// measures the enclosing scope as one call of a phase in every enabled backend
+class PhaseScope {
+public:
+    explicit PhaseScope(Phase phase) : phase(phase) {
+#ifdef DUNGEON_PROFILE
+        previous = profileEnter(phase);
+        start = readTicks();
+#endif
+#ifdef DUNGEON_TRACE
+        traceEvent(phaseName(phase), 'B');
+#endif
+#ifdef DUNGEON_PERF
+        perfRead(perfStart);
+#endif
+    }
+    ~PhaseScope() {
+#ifdef DUNGEON_PERF
+        perfPhaseEnd(phase, perfStart);
+#endif
+#ifdef DUNGEON_TRACE
+        traceEvent(phaseName(phase), 'E');
+#endif
+#ifdef DUNGEON_PROFILE
+        profileCurrent->calls++;
+        profileCurrent->ticks += readTicks() - start;
+        profileCurrent = previous;
+#endif
+    }
+    PhaseScope(const PhaseScope&) = delete;
+    PhaseScope& operator=(const PhaseScope&) = delete;
+private:
+    Phase phase;
+#ifdef DUNGEON_PROFILE
+    PhaseStats* previous;
+    std::uint64_t start;
+#endif
+#ifdef DUNGEON_PERF
+    PerfSample perfStart;
+#endif
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_PHASE(phase) PhaseScope PROFILE_CONCAT(profileScope, __LINE__)(phase)
+
+#else
+
+#define PROFILE_PHASE(phase)
+
+#endif
+
+#endif
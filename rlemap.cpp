@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <fstream>
+#include "rlemap.h"
+#include "mapops.h"
+#include "profile.h"
+
+namespace {
+
+// first run starting after col
+template <class Runs>
+typename Runs::const_iterator runAfter(const Runs& runs, int col) {
+    return std::upper_bound(runs.begin(), runs.end(), col,
+                            [](int value, const RleRun& run) { return value < run.start; });
+}
+
+// make room for extra more entries, growing geometrically, so inserts cannot throw
+template <class List>
+void makeRoom(List& list, std::size_t extra) {
+    if (list.capacity() - list.size() < extra) {
+        list.reserve(std::max(list.size() + extra, 2 * list.capacity()));
+    }
+}
+
+}
+
+bool RleMap::create(int rows, int cols) {
+    rowRuns.clear();
+    columnRows.clear();
+    runCount = 0;
+    maxRow = 0;
+    maxCol = 0;
+    if (rows <= 0 || cols <= 0) {
+        return false;
+    }
+    // the run lists come from tracked map memory, which throws when the budget refuses them
+    try {
+        rowRuns.resize(rows);
+        columnRows.resize(cols);
+    } catch (const std::bad_alloc&) {
+        rowRuns.clear();
+        columnRows.clear();
+        return false;
+    }
+    maxRow = rows;
+    maxCol = cols;
+    return true;
+}
+
+bool RleMap::load(char** map, int rows, int cols) {
+    if (!create(rows, cols)) {
+        return false;
+    }
+    try {
+        for (int i = 0; i < rows; ++i) {
+            encodeRow(i, map[i]);
+        }
+    } catch (const std::bad_alloc&) {
+        create(0, 0);
+        return false;
+    }
+    return true;
+}
+
+void RleMap::encodeRow(int row, const char* tiles) {
+    RunList& runs = rowRuns[row];
+    for (int j = 0; j < maxCol; ++j) {
+        if (tiles[j] == TILE_OPEN) {
+            continue;
+        }
+        columnRows[j].push_back(row);
+        if (!runs.empty() && runs.back().tile == tiles[j] && runs.back().start + runs.back().length == j) {
+            runs.back().length++;
+        } else {
+            runs.push_back(RleRun{j, 1, tiles[j]});
+        }
+    }
+    runCount += runs.size();
+}
+
+char RleMap::get(int row, int col) const {
+    const RunList& runs = rowRuns[row];
+    auto it = runAfter(runs, col);
+    if (it == runs.begin()) {
+        return TILE_OPEN;
+    }
+    --it;
+    return col < it->start + it->length ? it->tile : TILE_OPEN;
+}
+
+void RleMap::set(int row, int col, char tile) {
+    char old = get(row, col);
+    if (old == tile) {
+        return;
+    }
+
+    // a split can add two runs; reserve both lists before changing either
+    RowList& column = columnRows[col];
+    RunList& runs = rowRuns[row];
+    if (old == TILE_OPEN) {
+        makeRoom(column, 1);
+    }
+    makeRoom(runs, 2);
+
+    if (old == TILE_OPEN) {
+        column.insert(std::lower_bound(column.begin(), column.end(), row), row);
+    } else if (tile == TILE_OPEN) {
+        column.erase(std::lower_bound(column.begin(), column.end(), row));
+    }
+
+    std::size_t before = runs.size();
+    std::size_t i = runAfter(runs, col) - runs.begin();
+
+    // cut col out of the run holding it
+    if (i > 0 && runs[i - 1].start + runs[i - 1].length > col) {
+        RleRun run = runs[--i];
+        runs.erase(runs.begin() + i);
+        int right = run.start + run.length - col - 1;
+        if (right > 0) {
+            runs.insert(runs.begin() + i, RleRun{col + 1, right, run.tile});
+        }
+        if (col > run.start) {
+            runs.insert(runs.begin() + i, RleRun{run.start, col - run.start, run.tile});
+            ++i;
+        }
+    }
+
+    // runs before i end before col and runs from i start after it
+    if (tile != TILE_OPEN) {
+        bool joinLeft = i > 0 && runs[i - 1].tile == tile && runs[i - 1].start + runs[i - 1].length == col;
+        bool joinRight = i < runs.size() && runs[i].tile == tile && runs[i].start == col + 1;
+        if (joinLeft && joinRight) {
+            runs[i - 1].length += 1 + runs[i].length;
+            runs.erase(runs.begin() + i);
+        } else if (joinLeft) {
+            runs[i - 1].length++;
+        } else if (joinRight) {
+            runs[i].start--;
+            runs[i].length++;
+        } else {
+            runs.insert(runs.begin() + i, RleRun{col, 1, tile});
+        }
+    }
+    runCount = runCount + runs.size() - before;
+}
+
+int RleMap::nextInRow(int row, int col, int step) const {
+    const RunList& runs = rowRuns[row];
+    if (step > 0) {
+        auto it = runAfter(runs, col);
+        if (it != runs.begin() && std::prev(it)->start + std::prev(it)->length > col + 1) {
+            return col + 1;
+        }
+        return it == runs.end() ? maxCol : it->start;
+    }
+    auto it = runAfter(runs, col - 1);
+    if (it == runs.begin()) {
+        return -1;
+    }
+    --it;
+    return std::min(col - 1, it->start + it->length - 1);
+}
+
+int RleMap::nextInColumn(int col, int row, int step) const {
+    const RowList& column = columnRows[col];
+    if (step > 0) {
+        auto it = std::upper_bound(column.begin(), column.end(), row);
+        return it == column.end() ? maxRow : *it;
+    }
+    auto it = std::lower_bound(column.begin(), column.end(), row);
+    return it == column.begin() ? -1 : *std::prev(it);
+}
+
+std::uint64_t RleMap::bytes() const {
+    std::uint64_t total = rowRuns.capacity() * sizeof(RunList) + columnRows.capacity() * sizeof(RowList);
+    for (const RunList& runs : rowRuns) {
+        total += runs.capacity() * sizeof(RleRun);
+    }
+    for (const RowList& column : columnRows) {
+        total += column.capacity() * sizeof(int);
+    }
+    return total;
+}
+
+bool monsterAttack(RleMap& map, const Player& player) {
+    return monsterAttackSkipping(map, player);
+}
+
+bool loadRleLevel(const std::string& fileName, RleMap& map, Player& player) {
+    PROFILE_PHASE(PHASE_LOAD);
+    std::ifstream ifs(fileName);
+    if (!ifs.is_open()) {
+        cout << "Error: File unable to open: " << fileName << endl;
+        return false;
+    }
+    int maxRow = 0;
+    int maxCol = 0;
+    ifs >> maxRow >> maxCol;
+    ifs >> player.row >> player.col;
+    if (!ifs || !map.create(maxRow, maxCol) ||
+        player.row < 0 || player.row >= maxRow || player.col < 0 || player.col >= maxCol) {
+        cout << "Error: Map unable to open." << endl;
+        map.create(0, 0);
+        return false;
+    }
+
+    std::vector<char> line(maxCol, TILE_OPEN);
+    try {
+        for (int i = 0; i < maxRow; ++i) {
+            for (int j = 0; j < maxCol; ++j) {
+                ifs >> line[j];
+                if (!ifs || !isTile(line[j])) {
+                    cout << "Error: Map unable to open." << endl;
+                    map.create(0, 0);
+                    return false;
+                }
+            }
+            if (i == player.row) {
+                line[player.col] = TILE_PLAYER;
+            }
+            map.encodeRow(i, line.data());
+        }
+    } catch (const std::bad_alloc&) {
+        map.create(0, 0);
+        cout << "Error: Map unable to open." << endl;
+        return false;
+    }
+    return true;
+}
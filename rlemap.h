@@ -0,0 +1,129 @@
+#ifndef RLEMAP_H
+#define RLEMAP_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "logic.h"
+#include "mapmemory.h"
+
+// Map that stores each row as runs of non-open tiles.
+// TILE_OPEN is implicit, so memory and monster scans scale with the number of
+// non-open runs instead of the tile count. Each column also keeps the sorted rows
+// of its non-open tiles, so the vertical line-of-sight scans skip open stretches
+// too. Storage comes from tracked map memory.
+
+// levels whose non-open runs number at most this fraction of the tiles suit RLE
+const double RLE_MAX_RUN_DENSITY = 0.05;
+
+// tiles [start, start + length) all hold tile
+struct RleRun {
+    int start;
+    int length;
+    char tile;
+};
+
+class RleMap {
+public:
+    /**
+     * Make an all-TILE_OPEN map, releasing the current one.
+     * @param   maxRow      Number of rows.
+     * @param   maxCol      Number of columns.
+     * @return  true on success, false if the size is invalid or exceeds the memory budget.
+     */
+    bool create(int maxRow, int maxCol);
+
+    /**
+     * Encode a char** map.
+     * @param   map         Dungeon map.
+     * @param   maxRow      Number of rows.
+     * @param   maxCol      Number of columns.
+     * @return  true on success, false if the size is invalid or the runs exceed the
+     *          memory budget, leaving an empty map.
+     */
+    bool load(char** map, int maxRow, int maxCol);
+
+    int rows() const { return maxRow; }
+    int cols() const { return maxCol; }
+
+    /**
+     * Read one tile with a binary search over the row's runs.
+     * @return  the tile, TILE_OPEN between runs.
+     */
+    char get(int row, int col) const;
+
+    /**
+     * Write one tile, splitting or merging runs as needed.
+     * Throws std::bad_alloc if the run lists cannot grow within the memory budget; the
+     * map is then unchanged.
+     * @return None
+     */
+    void set(int row, int col, char tile);
+
+    /**
+     * Nearest non-open tile in the row, strictly left or right of col.
+     * @param   row         Row to search.
+     * @param   col         Starting column.
+     * @param   step        -1 to search left, 1 to search right.
+     * @return  its column, or -1 / cols() if there is none.
+     */
+    int nextInRow(int row, int col, int step) const;
+
+    /**
+     * Nearest non-open tile in the column, strictly above or below row.
+     * @param   col         Column to search.
+     * @param   row         Starting row.
+     * @param   step        -1 to search up, 1 to search down.
+     * @return  its row, or -1 / rows() if there is none.
+     */
+    int nextInColumn(int col, int row, int step) const;
+
+    // number of runs of non-open tiles
+    std::uint64_t runs() const { return runCount; }
+
+    // whether the level is sparse enough for this layout, see RLE_MAX_RUN_DENSITY
+    bool suited() const { return runCount <= RLE_MAX_RUN_DENSITY * maxRow * maxCol; }
+
+    // approximate bytes held by runs and the column index
+    std::uint64_t bytes() const;
+
+private:
+    // encode a row of an all-open map from tile characters
+    void encodeRow(int row, const char* tiles);
+
+    friend bool loadRleLevel(const std::string& fileName, RleMap& map, Player& player);
+
+    using RunList = std::vector<RleRun, MapAllocator<RleRun>>;
+    using RowList = std::vector<int, MapAllocator<int>>;
+
+    std::vector<RunList, MapAllocator<RunList>> rowRuns;
+    std::vector<RowList, MapAllocator<RowList>> columnRows;
+    int maxRow = 0;
+    int maxCol = 0;
+    std::uint64_t runCount = 0;
+};
+
+/**
+ * Move every monster in the player's line of sight one tile toward the player,
+ * visiting only the non-open tiles in the player's row and column.
+ * @param   map         RLE map.
+ * @param   player      Player object by reference for current location.
+ * @return  true if a monster reaches the player, false if not.
+ * @update map contents
+ */
+bool monsterAttack(RleMap& map, const Player& player);
+
+/**
+ * Load a level file straight into an RLE map. The file format and player handling
+ * match loadLevel.
+ * @param   fileName    File name of dungeon level.
+ * @param   map         RLE map to fill.
+ * @param   player      Player object by reference to set starting position.
+ * @return  true on success, false if the file cannot be read, ends early, holds a
+ *          character that is not a tile, places the player off the map or exceeds the
+ *          memory budget; the map is then left empty.
+ * @update  map, player
+ */
+bool loadRleLevel(const std::string& fileName, RleMap& map, Player& player);
+
+#endif
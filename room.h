@@ -0,0 +1,88 @@
+#ifndef ROOM_H
+#define ROOM_H
+
+#include <array>
+#include <tuple>
+#include "mapops.h"
+
+// Rooms whose dimensions are fixed at compile time.
+// Room<Rows, Cols> keeps its tiles in one std::array with constexpr bounds, so the
+// movePlayer and monsterAttack instantiations for it scan with constant strides and
+// trip counts. dispatchRoom picks the matching specialization for a loaded level.
+// Only the benchmark (roomMonsterAttack) uses them: against doMonsterAttack at the
+// supported sizes they measured within noise, faster at some sizes and slower at
+// others, while the game's entity store and pillar index work on the char** map, so
+// the game keeps that map for every room.
+
+template <int Rows, int Cols>
+class Room {
+public:
+    static_assert(Rows > 0 && Cols > 0, "a room needs at least one tile");
+
+    static constexpr int rows() { return Rows; }
+    static constexpr int cols() { return Cols; }
+    char get(int row, int col) const { return tiles[row * Cols + col]; }
+    void set(int row, int col, char tile) { tiles[row * Cols + col] = tile; }
+
+    /**
+     * Copy a char** map of the same dimensions into the room.
+     * @param   map         Dungeon map with Rows rows and Cols columns.
+     * @return None
+     */
+    void load(char** map) {
+        for (int i = 0; i < Rows; ++i) {
+            for (int j = 0; j < Cols; ++j) {
+                tiles[i * Cols + j] = map[i][j];
+            }
+        }
+    }
+
+    /**
+     * Copy the room back into a char** map of the same dimensions.
+     * @param   map         Dungeon map with Rows rows and Cols columns.
+     * @return None
+     */
+    void store(char** map) const {
+        for (int i = 0; i < Rows; ++i) {
+            for (int j = 0; j < Cols; ++j) {
+                map[i][j] = tiles[i * Cols + j];
+            }
+        }
+    }
+
+private:
+    std::array<char, Rows * Cols> tiles{};
+};
+
+// compile-time dimensions handed to a dispatchRoom callback
+template <int R, int C>
+struct RoomSize {
+    static constexpr int rows = R;
+    static constexpr int cols = C;
+    using type = Room<R, C>;
+};
+
+// room sizes that have a specialization
+using FixedRoomSizes = std::tuple<RoomSize<8, 8>, RoomSize<16, 16>, RoomSize<24, 24>,
+                                  RoomSize<32, 32>, RoomSize<64, 64>>;
+
+template <class F, class... Sizes>
+bool dispatchRoomSizes(int rows, int cols, F& callback, std::tuple<Sizes...>*) {
+    return ((rows == Sizes::rows && cols == Sizes::cols && (callback(Sizes{}), true)) || ...);
+}
+
+/**
+ * Call callback with the RoomSize matching the given dimensions, if there is one.
+ * The callback is a generic lambda taking the size, e.g.
+ *   dispatchRoom(rows, cols, [&](auto size) { typename decltype(size)::type room; ... });
+ * @param   rows        Number of rows in the level.
+ * @param   cols        Number of columns in the level.
+ * @param   callback    Called once with the matching RoomSize.
+ * @return  true if a specialization matched, false to use the generic char** path.
+ */
+template <class F>
+bool dispatchRoom(int rows, int cols, F&& callback) {
+    return dispatchRoomSizes(rows, cols, callback, static_cast<FixedRoomSizes*>(nullptr));
+}
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef ROOMARENA_H
+#define ROOMARENA_H
+#include <algorithm>
+#include <cstddef>
+#include "arena.h"
+#include "entities.h"
+#include "flowfield.h"
+#include "pillarindex.h"
+
+// Sizing of the arena the game keeps its room in. A room holds its map and either
+// its pillar index and entity store or its flow field, so the arena is sized for the
+// larger of the two at DUNGEON_SMALL_ROOM_TILES tiles.
+
+// rooms with at most this many tiles fit in SmallRoomArena's inline storage
+#ifndef DUNGEON_SMALL_ROOM_TILES
+#define DUNGEON_SMALL_ROOM_TILES 1024
+#endif
+
+// inline storage of SmallRoomArena
+const std::size_t SMALL_ROOM_ARENA_BYTES = smallRoomBytes(DUNGEON_SMALL_ROOM_TILES)
+                                         + std::max(pillarIndexBytes(DUNGEON_SMALL_ROOM_TILES)
+                                                        + entityStoreBytes(DUNGEON_SMALL_ROOM_TILES),
+                                                    flowFieldBytes(DUNGEON_SMALL_ROOM_TILES));
+
+// Arena meant to live in the game state. Rooms up to DUNGEON_SMALL_ROOM_TILES tiles
+// never reach the heap; larger rooms, or a map that resizeMap grows past the limit,
+// spill into heap chunks as usual.
+using SmallRoomArena = InlineArena<SMALL_ROOM_ARENA_BYTES>;
+
+#endif
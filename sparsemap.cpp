@@ -0,0 +1,302 @@
+#include <algorithm>
+#include <fstream>
+#include <initializer_list>
+#include "sparsemap.h"
+#include "helper.h"
+#include "mapops.h"
+#include "profile.h"
+
+namespace {
+
+// marks an unused slot; no (row, col) packs to it
+const std::uint64_t EMPTY_KEY = ~0ULL;
+
+// smallest table allocated
+const std::size_t MIN_CAPACITY = 64;
+
+std::uint64_t packKey(int high, int low) {
+    return (static_cast<std::uint64_t>(high) << 32) | static_cast<std::uint32_t>(low);
+}
+
+std::size_t slotOf(std::uint64_t key, std::size_t capacity) {
+    std::uint64_t mix = key * 0x9E3779B97F4A7C15ULL;
+    return static_cast<std::size_t>(mix ^ (mix >> 32)) & (capacity - 1);
+}
+
+// add position to the sorted list of line, creating the list if needed
+template <class Index>
+void addToLine(Index& lines, int line, int position) {
+    auto& list = lines[line];
+    try {
+        list.insert(std::lower_bound(list.begin(), list.end(), position), position);
+    } catch (const std::bad_alloc&) {
+        if (list.empty()) {
+            lines.erase(line);
+        }
+        throw;
+    }
+}
+
+// remove position from the list of line, dropping the list once it is empty
+template <class Index>
+void removeFromLine(Index& lines, int line, int position) {
+    auto found = lines.find(line);
+    auto& list = found->second;
+    list.erase(std::lower_bound(list.begin(), list.end(), position));
+    if (list.empty()) {
+        lines.erase(found);
+    }
+}
+
+// nearest position in the list of line strictly before or after position
+template <class Index>
+int nextInLine(const Index& lines, int line, int position, int step, int size) {
+    auto found = lines.find(line);
+    if (found == lines.end()) {
+        return step > 0 ? size : -1;
+    }
+    const auto& list = found->second;
+    if (step > 0) {
+        auto it = std::upper_bound(list.begin(), list.end(), position);
+        return it != list.end() ? *it : size;
+    }
+    auto it = std::lower_bound(list.begin(), list.end(), position);
+    return it != list.begin() ? *std::prev(it) : -1;
+}
+
+}
+
+SparseMap::~SparseMap() {
+    mapFree(keys);
+    mapFree(values);
+}
+
+bool SparseMap::create(int rows, int cols) {
+    mapFree(keys);
+    mapFree(values);
+    keys = nullptr;
+    values = nullptr;
+    capacity = 0;
+    count = 0;
+    rowLines.clear();
+    columnLines.clear();
+    maxRow = 0;
+    maxCol = 0;
+    if (rows <= 0 || cols <= 0) {
+        return false;
+    }
+    maxRow = rows;
+    maxCol = cols;
+    return true;
+}
+
+bool SparseMap::load(char** map, int rows, int cols) {
+    if (!create(rows, cols)) {
+        return false;
+    }
+    for (int i = 0; i < rows; ++i) {
+        for (int j = 0; j < cols; ++j) {
+            if (map[i][j] != TILE_OPEN) {
+                set(i, j, map[i][j]);
+            }
+        }
+    }
+    return true;
+}
+
+std::size_t SparseMap::find(std::uint64_t key) const {
+    std::size_t slot = slotOf(key, capacity);
+    while (keys[slot] != EMPTY_KEY && keys[slot] != key) {
+        slot = (slot + 1) & (capacity - 1);
+    }
+    return slot;
+}
+
+void SparseMap::grow() {
+    std::size_t larger = capacity == 0 ? MIN_CAPACITY : capacity * 2;
+    std::uint64_t* newKeys = static_cast<std::uint64_t*>(mapAlloc(larger * sizeof(std::uint64_t)));
+    char* newValues = static_cast<char*>(mapAlloc(larger));
+    if (newKeys == nullptr || newValues == nullptr) {
+        mapFree(newKeys);
+        mapFree(newValues);
+        throw std::bad_alloc();
+    }
+    std::fill(newKeys, newKeys + larger, EMPTY_KEY);
+
+    std::uint64_t* oldKeys = keys;
+    char* oldValues = values;
+    std::size_t oldCapacity = capacity;
+    keys = newKeys;
+    values = newValues;
+    capacity = larger;
+    for (std::size_t i = 0; i < oldCapacity; ++i) {
+        if (oldKeys[i] != EMPTY_KEY) {
+            std::size_t slot = find(oldKeys[i]);
+            keys[slot] = oldKeys[i];
+            values[slot] = oldValues[i];
+        }
+    }
+    mapFree(oldKeys);
+    mapFree(oldValues);
+}
+
+char SparseMap::get(int row, int col) const {
+    if (count == 0) {
+        return TILE_OPEN;
+    }
+    std::size_t slot = find(packKey(row, col));
+    return keys[slot] == EMPTY_KEY ? TILE_OPEN : values[slot];
+}
+
+void SparseMap::set(int row, int col, char tile) {
+    std::uint64_t key = packKey(row, col);
+
+    if (tile == TILE_OPEN) {
+        if (count == 0) {
+            return;
+        }
+        std::size_t slot = find(key);
+        if (keys[slot] == EMPTY_KEY) {
+            return;
+        }
+        // backward-shift deletion keeps every probe chain unbroken without tombstones
+        std::size_t mask = capacity - 1;
+        std::size_t next = slot;
+        while (true) {
+            next = (next + 1) & mask;
+            if (keys[next] == EMPTY_KEY) {
+                break;
+            }
+            std::size_t home = slotOf(keys[next], capacity);
+            if (((next - home) & mask) >= ((next - slot) & mask)) {
+                keys[slot] = keys[next];
+                values[slot] = values[next];
+                slot = next;
+            }
+        }
+        keys[slot] = EMPTY_KEY;
+        count--;
+        removeFromLine(rowLines, row, col);
+        removeFromLine(columnLines, col, row);
+        return;
+    }
+
+    if (capacity != 0) {
+        std::size_t slot = find(key);
+        if (keys[slot] != EMPTY_KEY) {
+            values[slot] = tile;
+            return;
+        }
+    }
+    if ((count + 1) * 2 > capacity) {
+        grow();
+    }
+    addToLine(rowLines, row, col);
+    try {
+        addToLine(columnLines, col, row);
+    } catch (const std::bad_alloc&) {
+        removeFromLine(rowLines, row, col);
+        throw;
+    }
+    std::size_t slot = find(key);
+    keys[slot] = key;
+    values[slot] = tile;
+    count++;
+}
+
+int SparseMap::nextInRow(int row, int col, int step) const {
+    return nextInLine(rowLines, row, col, step, maxCol);
+}
+
+int SparseMap::nextInColumn(int col, int row, int step) const {
+    return nextInLine(columnLines, col, row, step, maxRow);
+}
+
+std::uint64_t SparseMap::bytes() const {
+    // each list also takes a hash node: its key, the vector and the chain pointer
+    std::uint64_t total = capacity * (sizeof(std::uint64_t) + 1) +
+                          (rowLines.bucket_count() + columnLines.bucket_count()) * sizeof(void*);
+    for (const LineIndex* lines : {&rowLines, &columnLines}) {
+        for (const auto& entry : *lines) {
+            total += sizeof(entry) + sizeof(void*) + entry.second.capacity() * sizeof(int);
+        }
+    }
+    return total;
+}
+
+bool monsterAttack(SparseMap& map, const Player& player) {
+    return monsterAttackSkipping(map, player);
+}
+
+bool loadSparseLevel(const std::string& fileName, SparseMap& map, Player& player) {
+    PROFILE_PHASE(PHASE_LOAD);
+    std::ifstream ifs(fileName);
+    if (!ifs.is_open()) {
+        cout << "Error: File unable to open: " << fileName << endl;
+        return false;
+    }
+    int maxRow = 0;
+    int maxCol = 0;
+    long long entries = 0;
+    ifs >> maxRow >> maxCol >> player.row >> player.col >> entries;
+    if (!ifs || !map.create(maxRow, maxCol) || entries < 0 ||
+        player.row < 0 || player.row >= maxRow || player.col < 0 || player.col >= maxCol) {
+        cout << "Error: Map unable to open." << endl;
+        return false;
+    }
+
+    try {
+        for (long long n = 0; n < entries; ++n) {
+            int row = -1;
+            int col = -1;
+            char tile = TILE_OPEN;
+            ifs >> row >> col >> tile;
+            // the file lists only non-open tiles
+            if (!ifs || row < 0 || row >= maxRow || col < 0 || col >= maxCol || tile == TILE_OPEN || !isTile(tile)) {
+                cout << "Error: Map unable to open." << endl;
+                map.create(0, 0);
+                return false;
+            }
+            map.set(row, col, tile);
+        }
+        map.set(player.row, player.col, TILE_PLAYER);
+    } catch (const std::bad_alloc&) {
+        cout << "Error: Map unable to open." << endl;
+        map.create(0, 0);
+        return false;
+    }
+    return true;
+}
+
+void outputSparseViewport(const SparseMap& map, int top, int left, int height, int width) {
+    PROFILE_PHASE(PHASE_RENDER);
+    top = std::max(0, std::min(top, map.rows() - 1));
+    left = std::max(0, std::min(left, map.cols() - 1));
+    height = std::max(0, std::min(height, map.rows() - top));
+    width = std::max(0, std::min(width, map.cols() - left));
+    PROFILE_COUNT(COUNTER_BYTES_RENDERED, (height + 2LL) * (width * 1LL * DISPLAY_WIDTH + 3));
+
+    // one output line: the borders, DISPLAY_WIDTH characters per tile and a newline
+    std::vector<char> line(width * DISPLAY_WIDTH + 3, '-');
+    line.front() = '+';
+    line[line.size() - 2] = '+';
+    line.back() = '\n';
+    cout.write(line.data(), line.size());
+
+    line.front() = '|';
+    line[line.size() - 2] = '|';
+    for (int i = top; i < top + height; ++i) {
+        std::fill(line.begin() + 1, line.end() - 2, ' ');
+        // visit only the stored tiles inside the window
+        for (int j = map.nextInRow(i, left - 1, 1); j < left + width; j = map.nextInRow(i, j, 1)) {
+            line[1 + (j - left) * DISPLAY_WIDTH + 1] = map.get(i, j);
+        }
+        cout.write(line.data(), line.size());
+    }
+
+    std::fill(line.begin() + 1, line.end() - 2, '-');
+    line.front() = '+';
+    line[line.size() - 2] = '+';
+    cout.write(line.data(), line.size());
+    cout.flush();
+}
@@ -0,0 +1,144 @@
+#ifndef SPARSEMAP_H
+#define SPARSEMAP_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "logic.h"
+#include "mapmemory.h"
+
+// Map that stores only non-open tiles, for levels far larger than dense memory allows.
+// Tiles live in an open-addressing hash table keyed by the packed (row, col); missing
+// keys read as TILE_OPEN. Each row and column holding a non-open tile keeps a sorted
+// list of their positions, which gives the line-of-sight scans the next non-open tile
+// in a row or column; a monster step touches only the lists of its two lines. All
+// storage comes from tracked map memory, so it scales with the number of non-open
+// tiles only.
+//
+// Sparse level files list the non-open tiles instead of the full grid:
+//   <rows> <cols>
+//   <player row> <player col>
+//   <count>
+//   <row> <col> <tile>     (count lines)
+
+class SparseMap {
+public:
+    SparseMap() = default;
+    ~SparseMap();
+    SparseMap(const SparseMap&) = delete;
+    SparseMap& operator=(const SparseMap&) = delete;
+
+    /**
+     * Make an all-TILE_OPEN map, releasing the current tiles.
+     * @param   maxRow      Number of rows.
+     * @param   maxCol      Number of columns.
+     * @return  true on success, false if the size is invalid.
+     */
+    bool create(int maxRow, int maxCol);
+
+    /**
+     * Copy the non-open tiles of a char** map.
+     * @param   map         Dungeon map.
+     * @param   maxRow      Number of rows.
+     * @param   maxCol      Number of columns.
+     * @return  true on success, false if the size is invalid.
+     */
+    bool load(char** map, int maxRow, int maxCol);
+
+    int rows() const { return maxRow; }
+    int cols() const { return maxCol; }
+
+    /**
+     * Read one tile.
+     * @return  the tile, TILE_OPEN if none is stored.
+     */
+    char get(int row, int col) const;
+
+    /**
+     * Write one tile; writing TILE_OPEN removes it.
+     * Throws std::bad_alloc if the table cannot grow within the memory budget.
+     * @return None
+     */
+    void set(int row, int col, char tile);
+
+    /**
+     * Nearest non-open tile in the row, strictly left or right of col.
+     * @param   row         Row to search.
+     * @param   col         Starting column.
+     * @param   step        -1 to search left, 1 to search right.
+     * @return  its column, or -1 / cols() if there is none.
+     */
+    int nextInRow(int row, int col, int step) const;
+
+    /**
+     * Nearest non-open tile in the column, strictly above or below row.
+     * @param   col         Column to search.
+     * @param   row         Starting row.
+     * @param   step        -1 to search up, 1 to search down.
+     * @return  its row, or -1 / rows() if there is none.
+     */
+    int nextInColumn(int col, int row, int step) const;
+
+    // number of non-open tiles
+    std::uint64_t tiles() const { return count; }
+
+    // bytes held by the table and the line lists
+    std::uint64_t bytes() const;
+
+private:
+    // sorted positions of the non-open tiles of one row or column
+    using Line = std::vector<int, MapAllocator<int>>;
+    using LineIndex = std::unordered_map<int, Line, std::hash<int>, std::equal_to<int>,
+                                         MapAllocator<std::pair<const int, Line>>>;
+
+    // slot of key, or the empty slot where it would go
+    std::size_t find(std::uint64_t key) const;
+
+    // double the table, or allocate the first one
+    void grow();
+
+    std::uint64_t* keys = nullptr;
+    char* values = nullptr;
+    std::size_t capacity = 0;
+    std::uint64_t count = 0;
+    LineIndex rowLines;                 // row -> columns of its non-open tiles
+    LineIndex columnLines;              // column -> rows of its non-open tiles
+    int maxRow = 0;
+    int maxCol = 0;
+};
+
+/**
+ * Move every monster in the player's line of sight one tile toward the player,
+ * visiting only the non-open tiles in the player's row and column.
+ * @param   map         Sparse map.
+ * @param   player      Player object by reference for current location.
+ * @return  true if a monster reaches the player, false if not.
+ * @update map contents
+ */
+bool monsterAttack(SparseMap& map, const Player& player);
+
+/**
+ * Load a level in the sparse format described above.
+ * @param   fileName    File name of the sparse level.
+ * @param   map         Sparse map to fill.
+ * @param   player      Player object by reference to set starting position.
+ * @return  true on success, false if the file cannot be read, is malformed, lists an
+ *          open tile or a character that is not a tile, or exceeds the memory budget.
+ * @update  map, player
+ */
+bool loadSparseLevel(const std::string& fileName, SparseMap& map, Player& player);
+
+/**
+ * Print a window of the map in outputMap's format.
+ * The window is clamped to the map.
+ * @param   map         Sparse map.
+ * @param   top         First row of the window.
+ * @param   left        First column of the window.
+ * @param   height      Rows in the window.
+ * @param   width       Columns in the window.
+ * @return None
+ */
+void outputSparseViewport(const SparseMap& map, int top, int left, int height, int width);
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef TICKS_H
+#define TICKS_H
+#include <cstdint>
+#include <chrono>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/**
+ * Read the cycle counter (rdtsc on x86, steady_clock nanoseconds elsewhere).
+ * @return  current tick count.
+ */
+inline std::uint64_t readTicks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// pairs a tick reading with steady_clock so tick deltas can be converted to time
+struct TickCalibration {
+    std::uint64_t startTicks = readTicks();
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+    // ticks per nanosecond since construction
+    double rate() const {
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - startTime).count();
+        std::uint64_t ticks = readTicks() - startTicks;
+        return (ns > 0.0 && ticks > 0) ? ticks / ns : 1.0;
+    }
+};
+
+#endif
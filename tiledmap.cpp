@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include "tiledmap.h"
+#include "mapmemory.h"
+#include "mapops.h"
+#include "profile.h"
+
+namespace {
+
+// blocks start on a cache line
+const std::size_t BLOCK_ALIGNMENT = 64;
+
+}
+
+TiledMap::~TiledMap() {
+    mapFree(block);
+}
+
+bool TiledMap::create(int rows, int cols, TileOrder order) {
+    mapFree(block);
+    block = nullptr;
+    tiles = nullptr;
+    rowOffset = nullptr;
+    colOffset = nullptr;
+    blocks = 0;
+    maxRow = 0;
+    maxCol = 0;
+    if (rows <= 0 || cols <= 0) {
+        return false;
+    }
+
+    std::uint32_t rowBlocks = (rows + TILE_BLOCK - 1) >> TILE_BLOCK_SHIFT;
+    std::uint32_t colBlocks = (cols + TILE_BLOCK - 1) >> TILE_BLOCK_SHIFT;
+    std::uint64_t count = 1ULL * rowBlocks * colBlocks;
+    int rowBits = 0;
+    int colBits = 0;
+    if (order == TILE_ORDER_MORTON) {
+        while ((1ULL << rowBits) < rowBlocks) {
+            rowBits++;
+        }
+        while ((1ULL << colBits) < colBlocks) {
+            colBits++;
+        }
+        count = 1ULL << (rowBits + colBits);
+    }
+    // Z-order over the bits both sides have, then the longer side's high bits on top
+    const int sharedBits = std::min(rowBits, colBits);
+    const std::uint32_t sharedMask = (1u << sharedBits) - 1;
+    auto mortonPart = [&](std::uint32_t blockRow, std::uint32_t blockCol) {
+        std::uint64_t high = (blockRow >> sharedBits) | (blockCol >> sharedBits);
+        return mortonIndex(blockRow & sharedMask, blockCol & sharedMask) | (high << (2 * sharedBits));
+    };
+    std::uint64_t total = count * TILE_BLOCK * TILE_BLOCK;
+    std::uint64_t tables = (1ULL * rows + cols) * sizeof(std::uint64_t);
+    if (!mapMemoryFits(tables + total + BLOCK_ALIGNMENT)) {
+        return false;
+    }
+    block = mapAlloc(tables + total + BLOCK_ALIGNMENT);
+    if (block == nullptr) {
+        return false;
+    }
+    rowOffset = static_cast<std::uint64_t*>(block);
+    colOffset = rowOffset + rows;
+    std::uintptr_t address = reinterpret_cast<std::uintptr_t>(colOffset + cols);
+    tiles = reinterpret_cast<char*>((address + BLOCK_ALIGNMENT - 1) & ~(BLOCK_ALIGNMENT - 1));
+    std::memset(tiles, TILE_OPEN, total);
+
+    // block index bits of the row and the column never overlap, so the parts add
+    const int blockBits = 2 * TILE_BLOCK_SHIFT;
+    for (int i = 0; i < rows; ++i) {
+        std::uint32_t blockRow = static_cast<std::uint32_t>(i) >> TILE_BLOCK_SHIFT;
+        std::uint64_t blockPart = order == TILE_ORDER_MORTON ? mortonPart(blockRow, 0)
+                                                             : 1ULL * blockRow * colBlocks;
+        rowOffset[i] = (blockPart << blockBits) + ((i & (TILE_BLOCK - 1)) << TILE_BLOCK_SHIFT);
+    }
+    for (int j = 0; j < cols; ++j) {
+        std::uint32_t blockCol = static_cast<std::uint32_t>(j) >> TILE_BLOCK_SHIFT;
+        std::uint64_t blockPart = order == TILE_ORDER_MORTON ? mortonPart(0, blockCol) : blockCol;
+        colOffset[j] = (blockPart << blockBits) + (j & (TILE_BLOCK - 1));
+    }
+
+    blocks = count;
+    maxRow = rows;
+    maxCol = cols;
+    tileOrder = order;
+    return true;
+}
+
+bool TiledMap::load(char** map, int rows, int cols, TileOrder order) {
+    if (!create(rows, cols, order)) {
+        return false;
+    }
+    for (int i = 0; i < rows; ++i) {
+        for (int j = 0; j < cols; ++j) {
+            set(i, j, map[i][j]);
+        }
+    }
+    return true;
+}
+
+bool loadTiledLevel(const std::string& fileName, TiledMap& map, TileOrder order, Player& player) {
+    PROFILE_PHASE(PHASE_LOAD);
+    std::ifstream ifs(fileName);
+    if (!ifs.is_open()) {
+        cout << "Error: File unable to open: " << fileName << endl;
+        return false;
+    }
+    int maxRow = 0;
+    int maxCol = 0;
+    ifs >> maxRow >> maxCol;
+    ifs >> player.row >> player.col;
+    if (!ifs || !map.create(maxRow, maxCol, order) ||
+        player.row < 0 || player.row >= maxRow || player.col < 0 || player.col >= maxCol) {
+        cout << "Error: Map unable to open." << endl;
+        map.create(0, 0, order);
+        return false;
+    }
+
+    for (int i = 0; i < maxRow; ++i) {
+        for (int j = 0; j < maxCol; ++j) {
+            char tile = TILE_OPEN;
+            ifs >> tile;
+            if (!ifs || !isTile(tile)) {
+                cout << "Error: Map unable to open." << endl;
+                map.create(0, 0, order);
+                return false;
+            }
+            map.set(i, j, tile);
+        }
+    }
+    map.set(player.row, player.col, TILE_PLAYER);
+    return true;
+}
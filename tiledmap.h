@@ -0,0 +1,112 @@
+#ifndef TILEDMAP_H
+#define TILEDMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "logic.h"
+
+// Map stored as 8x8 blocks of tiles, one 64-byte cache line each.
+// Within a block tiles are row-major. The blocks themselves are laid out either
+// row-major (TILE_ORDER_BLOCKED) or along a Z-order curve (TILE_ORDER_MORTON), so
+// a column scan touches one cache line per eight tiles instead of one per tile, and
+// Morton order also keeps neighbouring blocks close in memory. The Morton grid is
+// padded to a power of two of blocks along each side, so at most four times the
+// blocks of the map; only the bits both sides share are interleaved, and the longer
+// side's remaining bits select among the resulting squares, so a long narrow map is
+// not padded to a square.
+// A tile's offset splits into a row part and a column part, which are precomputed
+// per row and per column, so get and set cost two table reads and an add in
+// either order.
+
+enum TileOrder {
+    TILE_ORDER_BLOCKED,
+    TILE_ORDER_MORTON
+};
+
+// side of a block, as a shift and in tiles
+const int TILE_BLOCK_SHIFT = 3;
+const int TILE_BLOCK = 1 << TILE_BLOCK_SHIFT;
+
+/**
+ * Interleave the bits of a block row and column into a Z-order index.
+ * @param   blockRow    Block row.
+ * @param   blockCol    Block column.
+ * @return  Morton index, column bits in the even positions.
+ */
+inline std::uint64_t mortonIndex(std::uint32_t blockRow, std::uint32_t blockCol) {
+    auto spread = [](std::uint64_t x) {
+        x = (x | (x << 16)) & 0x0000FFFF0000FFFFULL;
+        x = (x | (x << 8)) & 0x00FF00FF00FF00FFULL;
+        x = (x | (x << 4)) & 0x0F0F0F0F0F0F0F0FULL;
+        x = (x | (x << 2)) & 0x3333333333333333ULL;
+        x = (x | (x << 1)) & 0x5555555555555555ULL;
+        return x;
+    };
+    return spread(blockCol) | (spread(blockRow) << 1);
+}
+
+class TiledMap {
+public:
+    TiledMap() = default;
+    ~TiledMap();
+    TiledMap(const TiledMap&) = delete;
+    TiledMap& operator=(const TiledMap&) = delete;
+
+    /**
+     * Allocate an all-TILE_OPEN map, releasing the current one.
+     * @param   maxRow      Number of rows.
+     * @param   maxCol      Number of columns.
+     * @param   order       Block order.
+     * @return  true on success, false if the size is invalid or exceeds the memory budget.
+     */
+    bool create(int maxRow, int maxCol, TileOrder order);
+
+    /**
+     * Copy a char** map into blocks.
+     * @param   map         Dungeon map.
+     * @param   maxRow      Number of rows.
+     * @param   maxCol      Number of columns.
+     * @param   order       Block order.
+     * @return  true on success, false if the map cannot be allocated.
+     */
+    bool load(char** map, int maxRow, int maxCol, TileOrder order);
+
+    int rows() const { return maxRow; }
+    int cols() const { return maxCol; }
+    TileOrder order() const { return tileOrder; }
+
+    char get(int row, int col) const { return tiles[offset(row, col)]; }
+    void set(int row, int col, char tile) { tiles[offset(row, col)] = tile; }
+
+    // bytes held by the blocks, including padding
+    std::uint64_t bytes() const { return blocks * TILE_BLOCK * TILE_BLOCK; }
+
+private:
+    std::size_t offset(int row, int col) const { return rowOffset[row] + colOffset[col]; }
+
+    void* block = nullptr;
+    char* tiles = nullptr;
+    std::uint64_t* rowOffset = nullptr;
+    std::uint64_t* colOffset = nullptr;
+    std::uint64_t blocks = 0;
+    int maxRow = 0;
+    int maxCol = 0;
+    TileOrder tileOrder = TILE_ORDER_BLOCKED;
+};
+
+/**
+ * Load a level file straight into a tiled map. The file format and player handling
+ * match loadLevel.
+ * @param   fileName    File name of dungeon level.
+ * @param   map         Tiled map to fill.
+ * @param   order       Block order chosen for this level.
+ * @param   player      Player object by reference to set starting position.
+ * @return  true on success, false if the file cannot be read, ends early, holds a
+ *          character that is not a tile, places the player off the map or the map cannot
+ *          be allocated; the map is then left empty.
+ * @update  map, player
+ */
+bool loadTiledLevel(const std::string& fileName, TiledMap& map, TileOrder order, Player& player);
+
+#endif
@@ -0,0 +1,91 @@
+#include "trace.h"
+
+#ifdef DUNGEON_TRACE
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+thread_local TraceBuffer* traceLocal = nullptr;
+
+namespace {
+
+// owns every thread's buffer so events survive the threads that wrote them
+struct Tracer {
+    std::mutex lock;
+    std::vector<std::unique_ptr<TraceBuffer>> buffers;
+    TickCalibration calibration;
+
+    // the trace is written when the program exits, whichever way main returns
+    ~Tracer() {
+        const char* fileName = std::getenv("DUNGEON_TRACE_FILE");
+        traceWrite(fileName != nullptr ? fileName : "dungeon_trace.json");
+    }
+};
+
+Tracer& tracer() {
+    static Tracer instance;
+    return instance;
+}
+
+}
+
+TraceBuffer* traceRegisterThread() {
+    Tracer& t = tracer();
+    std::unique_ptr<TraceBuffer> buffer(new TraceBuffer);
+    std::lock_guard<std::mutex> guard(t.lock);
+    buffer->tid = t.buffers.size() + 1;
+    traceLocal = buffer.get();
+    t.buffers.push_back(std::move(buffer));
+    return traceLocal;
+}
+
+void traceThreadName(const char* name) {
+    if (traceLocal == nullptr) {
+        traceRegisterThread();
+    }
+    traceLocal->threadName = name;
+}
+
+bool traceWrite(const char* fileName) {
+    Tracer& t = tracer();
+    std::FILE* file = std::fopen(fileName, "w");
+    if (file == nullptr) {
+        std::fprintf(stderr, "Error: File unable to open: %s\n", fileName);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(t.lock);
+    double rate = t.calibration.rate();
+    bool first = true;
+    std::fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for (const std::unique_ptr<TraceBuffer>& buffer : t.buffers) {
+        if (buffer->threadName != nullptr) {
+            std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                         first ? "" : ",\n", buffer->tid, buffer->threadName);
+            first = false;
+        }
+
+        std::uint64_t head = buffer->head.load(std::memory_order_acquire);
+        std::uint64_t begin = head > TRACE_BUFFER_EVENTS ? head - TRACE_BUFFER_EVENTS : 0;
+        int depth = 0;
+        for (std::uint64_t i = begin; i < head; ++i) {
+            const TraceEvent& event = buffer->events[i % TRACE_BUFFER_EVENTS];
+            // after a wrap the oldest ends may have lost their begins
+            if (event.type == 'E' && depth == 0) {
+                continue;
+            }
+            depth += event.type == 'B' ? 1 : -1;
+            double us = (event.ticks - t.calibration.startTicks) / rate / 1000.0;
+            std::fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}",
+                         first ? "" : ",\n", event.name, event.type, us, buffer->tid);
+            first = false;
+        }
+    }
+    std::fprintf(file, "\n]}\n");
+    return std::fclose(file) == 0;
+}
+
+#endif
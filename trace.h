@@ -0,0 +1,97 @@
+#ifndef TRACE_H
+#define TRACE_H
+#include <cstdint>
+#include <atomic>
+#include "ticks.h"
+
+// Timeline tracing in the Chrome trace-event format (also read by Perfetto).
+// Compile with -DDUNGEON_TRACE and link trace.cpp to enable it. Each thread
+// appends begin/end events to its own ring buffer without locking; the buffers
+// are written as JSON to $DUNGEON_TRACE_FILE (default dungeon_trace.json) at exit.
+
+// events kept per thread; older events are overwritten once the ring is full
+const std::uint64_t TRACE_BUFFER_EVENTS = 1 << 16;
+
+#ifdef DUNGEON_TRACE
+
+// one begin ('B') or end ('E') event, name must be a string literal
+struct TraceEvent {
+    const char* name;
+    std::uint64_t ticks;
+    char type;
+};
+
+// single-producer ring of events owned by one thread
+struct TraceBuffer {
+    std::atomic<std::uint64_t> head{0};
+    TraceEvent events[TRACE_BUFFER_EVENTS];
+    int tid = 0;
+    const char* threadName = nullptr;
+};
+
+// calling thread's buffer, or nullptr until it records its first event
+extern thread_local TraceBuffer* traceLocal;
+
+/**
+ * Allocate and register the calling thread's buffer. Takes a lock once per thread.
+ * @return  the new buffer, also stored in traceLocal.
+ */
+TraceBuffer* traceRegisterThread();
+
+/**
+ * Name the calling thread in the trace viewer.
+ * @param   name        String literal naming the thread.
+ * @return None
+ */
+void traceThreadName(const char* name);
+
+/**
+ * Write all buffers to a trace file. Also runs automatically at program exit.
+ * @param   fileName    Destination JSON file.
+ * @return  true if the file was written.
+ */
+bool traceWrite(const char* fileName);
+
+/**
+ * Append an event to the calling thread's ring.
+ * @param   name        String literal naming the span.
+ * @param   type        'B' for begin, 'E' for end.
+ * @return None
+ */
+inline void traceEvent(const char* name, char type) {
+    TraceBuffer* buffer = traceLocal;
+    if (buffer == nullptr) {
+        buffer = traceRegisterThread();
+    }
+    std::uint64_t head = buffer->head.load(std::memory_order_relaxed);
+    TraceEvent& event = buffer->events[head % TRACE_BUFFER_EVENTS];
+    event.name = name;
+    event.ticks = readTicks();
+    event.type = type;
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+// records the enclosing scope as one span
+class TraceScope {
+public:
+    explicit TraceScope(const char* name) : name(name) { traceEvent(name, 'B'); }
+    ~TraceScope() { traceEvent(name, 'E'); }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+private:
+    const char* name;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TRACE_THREAD_NAME(name) traceThreadName(name)
+
+#else
+
+#define TRACE_SCOPE(name)
+#define TRACE_THREAD_NAME(name)
+
+#endif
+
+#endif
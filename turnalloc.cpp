@@ -0,0 +1,243 @@
+// Allocation check for the turn loop.
+// Plays thousands of scripted turns the way main() does and fails if any turn or
+// level load allocates, not counting resizeMap past the small-room limit. Then loads
+// a room too large for the arena and fails unless resizeMap grows it in place.
+// Build:  g++ -std=c++17 -O2 turnalloc.cpp alloccount.cpp logic.cpp helper.cpp mapmemory.cpp arena.cpp pillarindex.cpp entities.cpp -pthread -o turnalloc
+// Usage:  ./turnalloc [TURNS]
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <random>
+#include <cstdio>
+#include <cstdlib>
+#include "alloccount.h"
+#include "entities.h"
+#include "helper.h"
+#include "logic.h"
+#include "mapmemory.h"
+#include "pillarindex.h"
+#include "roomarena.h"
+using std::cout, std::cerr, std::endl, std::string, std::ofstream;
+
+// side length of the generated level
+const int LEVEL_SIZE = 24;
+
+// side length of the level whose map is mapped from the OS rather than the arena
+const int LARGE_LEVEL_SIZE = 1024;
+
+// stream buffer that discards everything, so output formatting still runs
+class NullBuffer : public std::streambuf {
+public:
+    NullBuffer() { setp(buffer, buffer + sizeof(buffer)); }
+protected:
+    int overflow(int c) override {
+        setp(buffer, buffer + sizeof(buffer));
+        return c == EOF ? 0 : c;
+    }
+private:
+    char buffer[4096];
+};
+
+/**
+ * Write a random level with pillars, monsters, treasure, an amulet, a door and an exit.
+ * @param   fileName    Destination file.
+ * @param   size        Side length of the level.
+ * @return  true if the file was written.
+ */
+bool writeLevel(const string& fileName, int size) {
+    ofstream ofs(fileName);
+    if (!ofs.is_open()) {
+        return false;
+    }
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> roll(0, 99);
+    ofs << size << " " << size << "\n" << size / 2 << " " << size / 2 << "\n";
+    for (int i = 0; i < size; ++i) {
+        for (int j = 0; j < size; ++j) {
+            int r = roll(rng);
+            char tile = TILE_OPEN;
+            if (i == 0 && j == 0) {
+                tile = TILE_DOOR;
+            } else if (i == size - 1 && j == size - 1) {
+                tile = TILE_EXIT;
+            } else if (i == size / 2 - 1 && j == size / 2) {
+                tile = TILE_AMULET;
+            } else if (r < 8) {
+                tile = TILE_PILLAR;
+            } else if (r < 11) {
+                tile = TILE_MONSTER;
+            } else if (r < 14) {
+                tile = TILE_TREASURE;
+            }
+            ofs << tile;
+        }
+        ofs << "\n";
+    }
+    return static_cast<bool>(ofs);
+}
+
+/**
+ * Load a level too large for the room arena with the arena set, as main() does, and
+ * double it with resizeMap.
+ * @param   fileName    Scratch level file.
+ * @return  true if the map grew inside its own block, without a new allocation.
+ */
+bool resizesInPlace(const string& fileName) {
+    if (!writeLevel(fileName, LARGE_LEVEL_SIZE)) {
+        return false;
+    }
+    SmallRoomArena roomArena;
+    setMapArena(&roomArena);
+    Player player;
+    int maxRow = 0;
+    int maxCol = 0;
+    char** map = loadLevel(fileName, maxRow, maxCol, player);
+    std::remove(fileName.c_str());
+    bool grown = false;
+    if (map != nullptr) {
+        std::uint64_t allocations = mapMemoryStats().allocations;
+        int oldRow = maxRow;
+        map = resizeMap(map, maxRow, maxCol, player);
+        grown = maxRow == 2 * oldRow && mapMemoryStats().allocations == allocations;
+        deleteMap(map, maxRow);
+    }
+    setMapArena(nullptr);
+    return grown;
+}
+
+int main(int argc, char** argv) {
+    int turns = argc > 1 ? std::atoi(argv[1]) : 5000;
+    string fileName = "turnalloc_level.txt";
+    if (turns <= 0 || !writeLevel(fileName, LEVEL_SIZE)) {
+        cerr << "Usage: " << argv[0] << " [TURNS]" << endl;
+        return 1;
+    }
+
+    // script the commands up front so building them is not counted
+    const char commands[] = {MOVE_UP, MOVE_LEFT, MOVE_DOWN, MOVE_RIGHT, INPUT_STAY};
+    std::mt19937 rng(11);
+    std::uniform_int_distribution<int> pick(0, 4);
+    string script;
+    for (int i = 0; i < turns; ++i) {
+        script += commands[pick(rng)];
+        script += '\n';
+    }
+    std::istringstream in(script);
+
+    NullBuffer sink;
+    std::streambuf* saved = cout.rdbuf(&sink);
+
+    Player player;
+    int maxRow = 0;
+    int maxCol = 0;
+    char** map = nullptr;
+    int total_moves = 0;
+    int loads = 0;
+    int resizes = 0;
+    int allocatingTurns = 0;
+    std::uint64_t turnAllocations = 0;
+    std::uint64_t loadAllocations = 0;
+
+    SmallRoomArena roomArena;
+    setMapArena(&roomArena);
+    PillarIndex pillars;
+    EntityStore entities;
+
+    for (int turn = 0; turn < turns; ++turn) {
+        if (map == nullptr) {
+            player = Player();
+            std::uint64_t loadStart = allocationCount();
+            map = loadLevel(fileName, maxRow, maxCol, player, entities);
+            if (map != nullptr) {
+                pillars.build(map, maxRow, maxCol);
+            }
+            loadAllocations += allocationCount() - loadStart;
+            if (map == nullptr) {
+                cout.rdbuf(saved);
+                cerr << "Error: unable to load " << fileName << endl;
+                return 1;
+            }
+            outputMap(map, maxRow, maxCol);
+            loads++;
+        }
+
+        std::uint64_t before = allocationCount();
+        std::uint64_t excluded = 0;
+
+        // the same sequence of calls as one iteration of the loop in main()
+        char input = 0;
+        int status = STATUS_STAY;
+        cout << "Enter command (w,a,s,d: move, e: stay still, q: quit): ";
+        in >> input;
+        total_moves++;
+        if (input == INPUT_STAY) {
+            status = STATUS_STAY;
+        } else {
+            int nextRow = player.row;
+            int nextCol = player.col;
+            getDirection(input, nextRow, nextCol);
+            status = doPlayerMove(map, maxRow, maxCol, player, nextRow, nextCol, entities);
+        }
+
+        bool roomOver = false;
+        if (status == STATUS_ESCAPE || status == STATUS_LEAVE) {
+            outputMap(map, maxRow, maxCol);
+            outputStatus(status, player, total_moves);
+            roomOver = true;
+        } else if (pillars.built() ? doMonsterAttack(map, maxRow, maxCol, player, pillars, entities)
+                                   : doMonsterAttack(map, maxRow, maxCol, player, entities)) {
+            outputMap(map, maxRow, maxCol);
+            cout << "You died, adventurer! Better luck next time!" << endl;
+            roomOver = true;
+        } else {
+            if (status == STATUS_AMULET) {
+                std::uint64_t resizeStart = allocationCount();
+                map = resizeMap(map, maxRow, maxCol, player);
+                pillars.build(map, maxRow, maxCol);
+                entities.build(map, maxRow, maxCol);
+                excluded += allocationCount() - resizeStart;
+                resizes++;
+            }
+            outputMap(map, maxRow, maxCol);
+            outputStatus(status, player, total_moves);
+        }
+
+        std::uint64_t allocations = allocationCount() - before - excluded;
+        if (allocations > 0) {
+            allocatingTurns++;
+            turnAllocations += allocations;
+        }
+
+        if (roomOver) {
+            entities.release();
+            pillars.release();
+            deleteMap(map, maxRow);
+            roomArena.reset();
+            map = nullptr;
+        }
+    }
+    if (map != nullptr) {
+        entities.release();
+        pillars.release();
+        deleteMap(map, maxRow);
+    }
+    cout.rdbuf(saved);
+    std::remove(fileName.c_str());
+
+    cout << turns << " turns, " << loads << " level loads, " << resizes << " resizes" << endl;
+    cout << loadAllocations << " allocations in level loads, " << roomArena.chunks()
+         << " arena chunks" << endl;
+    cout << allocatingTurns << " turns allocated, " << turnAllocations << " allocations in total" << endl;
+    if (allocatingTurns > 0 || loadAllocations > 0) {
+        cout << "FAILED: the turn loop or level loading allocates" << endl;
+        return 1;
+    }
+    cout << "OK: no allocations per turn or level load" << endl;
+    if (!resizesInPlace(fileName)) {
+        cout << "FAILED: resizeMap copied a room too large for the arena" << endl;
+        return 1;
+    }
+    cout << "OK: resizeMap grows a large room in place" << endl;
+    return 0;
+}